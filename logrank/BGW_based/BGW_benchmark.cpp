@@ -0,0 +1,202 @@
+//
+// Throughput of BGW share multiplication (plain and packed) against the CKKS randomized evaluation.
+//
+
+#include <chrono>
+#include <numeric>
+#include <queue>
+#include "BGW_multiplication.h"
+#include "BGW_packed_sharing.h"
+#include "../../../examples.h"
+#include "../CKKS_based/client.h"
+#include "../CKKS_based/evaluator_server.h"
+#include "../CKKS_based/logrank_simulation.h"
+#include "../CKKS_based/serv_func.h"
+using namespace std;
+using namespace seal;
+
+/*  mults/sec of the BGW network for batches of random field elements  */
+void BGW_multiplication_benchmark(const vector<size_t>& batch_sizes, int n, int t, int prime_bits)
+{
+    Prime_Field field(find_prime(prime_bits));
+    BGW_network network(field, n, t, 1);
+    mt19937_64 gen(2);
+
+    for (size_t batch : batch_sizes)
+    {
+        vector<uint64_t> a(batch), b(batch);
+        for (size_t k = 0; k < batch; k++)
+        {
+            a[k] = field.random(gen);
+            b[k] = field.random(gen);
+        }
+        vector<vector<uint64_t>> a_shares = shamir_share_batch(field, a, t, n, gen);
+        vector<vector<uint64_t>> b_shares = shamir_share_batch(field, b, t, n, gen);
+
+        chrono::high_resolution_clock::time_point time_start = chrono::high_resolution_clock::now();
+        vector<vector<uint64_t>> c_shares = network.multiply(a_shares, b_shares);
+        chrono::microseconds mult_time =
+            chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - time_start);
+
+        /*  Spot check  */
+        vector<int> parties(t + 1);
+        std::iota(parties.begin(), parties.end(), 0);
+        if (shamir_reconstruct_batch(field, c_shares, parties)[batch - 1] != field.mul(a[batch - 1], b[batch - 1]))
+        {
+            std::cout << "---- ERROR!! ----- BGW product is wrong" << std::endl;
+            throw;
+        }
+
+        std::cout << " BGW n=" << n << " t=" << t << ", batch " << batch << ": "
+                  << batch * 1000000.0 / max(1.0, (double)mult_time.count()) << " mults/sec" << std::endl;
+    }
+}
+/*  evaluate_with_random multiplies T0 R, R^2 and T1 R^2: three ciphertext products of slot_count values each  */
+void CKKS_random_evaluation_benchmark(int num_of_clients, int repetitions)
+{
+    std::queue<Cipher_Msg> enc_msg_q;
+    const int scale_cost_param = 30;
+    double scale = pow(2.0, scale_cost_param);
+
+    std::shared_ptr<SEALContext> context = create_context(scale_cost_param);
+    std::shared_ptr<CKKSEncoder> encoder = create_encoder(context);
+    KeyGenerator keygen(context);
+    Encryptor encryptor(context, keygen.public_key());
+    evaluator_server eval_server(context, keygen.relin_keys_local(), &enc_msg_q, scale);
+
+    chrono::microseconds eval_time(0);
+    for (int rep = 0; rep < repetitions; rep++)
+    {
+        for (int i = 0; i < num_of_clients; i++)
+        {
+            enc_msg_q.push(create_encrypted_msg(*encoder, encryptor, scale, rand() % 32, 10, 5, 1 + rand() % 16));
+        }
+        chrono::high_resolution_clock::time_point time_start = chrono::high_resolution_clock::now();
+        eval_server.evaluate_with_random();
+        eval_time += chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - time_start);
+    }
+
+    double per_sec = repetitions * 1000000.0 / max(1.0, (double)eval_time.count());
+    std::cout << " CKKS evaluate_with_random, " << num_of_clients << " clients: " << 3 * per_sec
+              << " ciphertext mults/sec, " << 3 * per_sec * encoder->slot_count() << " slot mults/sec" << std::endl;
+}
+
+/*  num_of_tests biomarker tests, each randomized as in the logrank protocol: D = T0 R and U = T1 R^2.
+ *  Plain Shamir shares and multiplies every value on its own; packed sharing puts k tests in one polynomial.
+ *  Both take the same two rounds, the packed one sends 1/k of the elements.  */
+void BGW_packed_benchmark(size_t num_of_tests, int n, int t, const vector<int>& pack_sizes, int prime_bits)
+{
+    Prime_Field field(find_prime(prime_bits));
+    mt19937_64 gen(3);
+
+    vector<long long int> T0(num_of_tests), T1(num_of_tests), R(num_of_tests);
+    vector<uint64_t> T0_T1(2 * num_of_tests), R_R(2 * num_of_tests), R_only(num_of_tests);
+    for (size_t j = 0; j < num_of_tests; j++)
+    {
+        T0[j] = (long long int)(gen() % 2001) - 1000;
+        T1[j] = (long long int)(gen() % 100000);
+        R[j] = 1 + (long long int)(gen() % 16);
+        T0_T1[j] = field.from_signed(T0[j]);
+        T0_T1[num_of_tests + j] = field.from_signed(T1[j]);
+        R_R[j] = R_R[num_of_tests + j] = R_only[j] = field.from_signed(R[j]);
+    }
+
+    auto verify = [&](const vector<uint64_t>& T0R_T1R, const vector<uint64_t>& T1RR) {
+        for (size_t j = 0; j < num_of_tests; j++)
+        {
+            if (field.to_signed(T0R_T1R[j]) != T0[j] * R[j] || field.to_signed(T1RR[j]) != T1[j] * R[j] * R[j])
+            {
+                std::cout << "---- ERROR!! ----- test " << j << " reconstructed wrong" << std::endl;
+                throw;
+            }
+        }
+    };
+
+    /*  1. Plain Shamir, one polynomial per value  */
+    {
+        BGW_network network(field, n, t, 1);
+        chrono::high_resolution_clock::time_point time_start = chrono::high_resolution_clock::now();
+        vector<vector<uint64_t>> T0_T1_shares = shamir_share_batch(field, T0_T1, t, n, gen);
+        vector<vector<uint64_t>> R_R_shares = shamir_share_batch(field, R_R, t, n, gen);
+        vector<vector<uint64_t>> R_shares = shamir_share_batch(field, R_only, t, n, gen);
+        size_t input_elements = (T0_T1_shares[0].size() + R_R_shares[0].size() + R_shares[0].size()) * n;
+
+        vector<vector<uint64_t>> T0R_T1R = network.multiply(T0_T1_shares, R_R_shares);
+        vector<vector<uint64_t>> T1R(n);
+        for (int i = 0; i < n; i++)
+        {
+            T1R[i].assign(T0R_T1R[i].begin() + num_of_tests, T0R_T1R[i].end());
+        }
+        vector<vector<uint64_t>> T1RR = network.multiply(T1R, R_shares);
+
+        vector<int> parties(t + 1);
+        std::iota(parties.begin(), parties.end(), 0);
+        vector<uint64_t> opened_T0R_T1R = shamir_reconstruct_batch(field, T0R_T1R, parties);
+        vector<uint64_t> opened_T1RR = shamir_reconstruct_batch(field, T1RR, parties);
+        chrono::microseconds total_time =
+            chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - time_start);
+        verify(opened_T0R_T1R, opened_T1RR);
+
+        std::cout << " Shamir n=" << n << " t=" << t << ", " << num_of_tests << " tests: " << total_time.count() / 1000
+                  << " ms, " << input_elements << " input share elements, " << network.get_elements_sent()
+                  << " elements in " << network.get_rounds() << " rounds" << std::endl;
+    }
+
+    /*  2. Packed, k tests per polynomial  */
+    for (int k : pack_sizes)
+    {
+        BGW_network network(field, n, t, 1);
+        Packed_BGW packed(network, k);
+        chrono::high_resolution_clock::time_point time_start = chrono::high_resolution_clock::now();
+
+        /*  T0 and T1 are packed separately so the second product can take the T1 R blocks as they are  */
+        vector<uint64_t> T0_only(T0_T1.begin(), T0_T1.begin() + num_of_tests);
+        vector<uint64_t> T1_only(T0_T1.begin() + num_of_tests, T0_T1.end());
+        vector<vector<uint64_t>> T0_shares = packed.share_batch(T0_only, gen);
+        vector<vector<uint64_t>> T1_shares = packed.share_batch(T1_only, gen);
+        vector<vector<uint64_t>> R_shares = packed.share_batch(R_only, gen);
+        size_t blocks = R_shares[0].size();
+        size_t input_elements = 3 * blocks * n;
+
+        vector<vector<uint64_t>> T0_T1_shares(T0_shares), R_R_shares(R_shares);
+        for (int i = 0; i < n; i++)
+        {
+            T0_T1_shares[i].insert(T0_T1_shares[i].end(), T1_shares[i].begin(), T1_shares[i].end());
+            R_R_shares[i].insert(R_R_shares[i].end(), R_shares[i].begin(), R_shares[i].end());
+        }
+        vector<vector<uint64_t>> T0R_T1R = packed.multiply(T0_T1_shares, R_R_shares);
+        vector<vector<uint64_t>> T0R(n), T1R(n);
+        for (int i = 0; i < n; i++)
+        {
+            T0R[i].assign(T0R_T1R[i].begin(), T0R_T1R[i].begin() + blocks);
+            T1R[i].assign(T0R_T1R[i].begin() + blocks, T0R_T1R[i].end());
+        }
+        vector<vector<uint64_t>> T1RR = packed.multiply(T1R, R_shares);
+
+        vector<int> parties(packed.get_degree() + 1);
+        std::iota(parties.begin(), parties.end(), 0);
+        vector<uint64_t> opened_T0R_T1R = packed.reconstruct_batch(T0R, parties, num_of_tests);
+        vector<uint64_t> opened_T1R = packed.reconstruct_batch(T1R, parties, num_of_tests);
+        opened_T0R_T1R.insert(opened_T0R_T1R.end(), opened_T1R.begin(), opened_T1R.end());
+        vector<uint64_t> opened_T1RR = packed.reconstruct_batch(T1RR, parties, num_of_tests);
+        chrono::microseconds total_time =
+            chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - time_start);
+        verify(opened_T0R_T1R, opened_T1RR);
+
+        std::cout << " Packed k=" << k << " n=" << n << " t=" << t << ", " << num_of_tests << " tests: "
+                  << total_time.count() / 1000 << " ms, " << input_elements << " input share elements, "
+                  << network.get_elements_sent() << " elements in " << network.get_rounds() << " rounds" << std::endl;
+    }
+}
+
+void example_bgw_multiplication_test()
+{
+    BGW_multiplication_benchmark({1, 1000, 100000, 1000000}, 5, 2, 53);
+    CKKS_random_evaluation_benchmark(5, 10);
+}
+
+void example_bgw_packed_sharing_test()
+{
+    /*  n = 13 tolerates t = 2 with up to k = 5 tests per polynomial; |T1 R^2| < 2^25 fits a 42-bit field  */
+    BGW_packed_benchmark(100000, 13, 2, {1, 3, 5}, 42);
+}
@@ -0,0 +1,506 @@
+//
+// Fixed-point arithmetic on BGW shares: truncation, comparison, reciprocal and inverse square root.
+//
+
+#ifndef SEAL_BGW_FIXED_POINT_H
+#define SEAL_BGW_FIXED_POINT_H
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+#include "BGW_multiplication.h"
+#include "BGW_shamir.h"
+
+/*  The Mersenne prime 2^61 - 1: room for 43-bit fixed-point values with 16 bits of statistical masking  */
+const uint64_t FIXED_POINT_PRIME = (1ULL << 61) - 1;
+
+/*  Newton iteration for 1/x or 1/sqrt(x) on a public range [lo, hi] (from the study design, as for the
+ *  CKKS inverse square root): with u = x / hi in [lo / hi, 1]
+ *      y0 = a + b u                      (least-squares fit, relative error weighted)
+ *      y <- y (2 - u y)                  reciprocal,       converges if 0 < u y0 < 2
+ *      y <- y (3 - u y^2) / 2            inverse sqrt,     converges if 0 < u y0^2 < 3
+ *  y approximates 1/u = hi/x, resp. 1/sqrt(u) = sqrt(hi/x); the caller applies the public 1/hi (1/sqrt(hi)).  */
+struct Newton_Plan
+{
+    bool inverse_sqrt;
+    double lo;
+    double hi;
+    double a;
+    double b;
+    size_t iterations;
+    double max_rel_error;   // of the approximation alone, over the range
+};
+
+inline double newton_approximation(const Newton_Plan& plan, double u, size_t iterations)
+{
+    double y = plan.a + plan.b * u;
+    for (size_t i = 0; i < iterations; i++)
+    {
+        y = plan.inverse_sqrt ? y * (1.5 - 0.5 * u * y * y) : y * (2 - u * y);
+    }
+    return y;
+}
+
+/*  The fewest Newton steps that bring the relative error under tolerance  */
+inline Newton_Plan plan_newton(bool inverse_sqrt, double lo, double hi, double tolerance, size_t max_iterations)
+{
+    if (!(lo > 0 && hi > lo))
+    {
+        throw invalid_argument("plan_newton: need 0 < lo < hi");
+    }
+
+    Newton_Plan plan;
+    plan.inverse_sqrt = inverse_sqrt;
+    plan.lo = lo;
+    plan.hi = hi;
+
+    /*  min sum (g(u) (a + b u) - 1)^2, g(u) = sqrt(u) or u - the 2x2 normal equations  */
+    const size_t grid = 4096;
+    double u_low = lo / hi;
+    double s11 = 0, s12 = 0, s22 = 0, r1 = 0, r2 = 0;
+    for (size_t i = 0; i <= grid; i++)
+    {
+        double u = u_low + (1.0 - u_low) * i / grid;
+        double f0 = inverse_sqrt ? sqrt(u) : u, f1 = u * f0;
+        s11 += f0 * f0;
+        s12 += f0 * f1;
+        s22 += f1 * f1;
+        r1 += f0;
+        r2 += f1;
+    }
+    double det = s11 * s22 - s12 * s12;
+    plan.a = (r1 * s22 - r2 * s12) / det;
+    plan.b = (s11 * r2 - s12 * r1) / det;
+
+    for (size_t i = 0; i <= grid; i++)
+    {
+        double u = u_low + (1.0 - u_low) * i / grid;
+        double y0 = plan.a + plan.b * u;
+        double contraction = inverse_sqrt ? u * y0 * y0 / 3 : u * y0 / 2;
+        if (y0 <= 0 || contraction >= 1)
+        {
+            throw invalid_argument("plan_newton: range too wide for the Newton iteration to converge");
+        }
+    }
+
+    for (plan.iterations = 0; ; plan.iterations++)
+    {
+        if (plan.iterations > max_iterations)
+        {
+            throw invalid_argument("plan_newton: tolerance not reachable within max_iterations");
+        }
+        plan.max_rel_error = 0;
+        for (size_t i = 0; i <= grid; i++)
+        {
+            double u = u_low + (1.0 - u_low) * i / grid;
+            double exact = inverse_sqrt ? 1 / sqrt(u) : 1 / u;
+            plan.max_rel_error = max(plan.max_rel_error, std::abs(newton_approximation(plan, u, plan.iterations) / exact - 1));
+        }
+        if (plan.max_rel_error <= tolerance)
+        {
+            break;
+        }
+    }
+    return plan;
+}
+
+/*  Fixed point on top of BGW_network: a real x is the field element round(x 2^f), |x 2^f| < 2^(l-1).
+ *  Every shared batch is shares[i][k], party i's share of value k, as in BGW_network.
+ *
+ *  Truncation and comparison use correlated randomness from a dealer (the preprocessing phase: shared
+ *  random values and random bits, independent of the inputs, so they are not counted as rounds):
+ *      truncate(a, m)        c = open(a + 2^(l-1) + r),  r = r_high 2^m + r_low masking a with kappa extra bits
+ *                            a / 2^m ~ (c >> m) - r_high - 2^(l-1-m), off by at most one unit   (1 round)
+ *      less_than_zero(a)     exact: a mod 2^(l-1) = c' - r' + 2^(l-1) [c' < r'] with r' shared bit by bit,
+ *                            [c' < r'] by a log-depth prefix over the bits, then [a < 0] = -(a - a mod 2^(l-1)) / 2^(l-1)
+ *                            (1 + ceil(log2(l-1)) rounds)
+ *  The field must hold l + kappa + 1 bits. A product of two values carries 2f fraction bits, so it must stay
+ *  below 2^(l-1-2f) in magnitude before the truncation back to f bits.
+ *  get_rounds() counts every communication round of the network: multiplications and openings.  */
+class BGW_fixed_point
+{
+private:
+    BGW_network& network;
+    Prime_Field field;
+    int n;
+    int t;
+    int fraction_bits;
+    int value_bits;
+    int security_bits;
+    mt19937_64 dealer;
+    size_t preprocessing_elements = 0;
+
+    uint64_t power_of_two(int exponent) const
+    {
+        return field.pow(2, exponent);
+    }
+
+    /*  The dealer shares values[k] as a batch  */
+    vector<vector<uint64_t>> deal(const vector<uint64_t>& values)
+    {
+        preprocessing_elements += values.size() * n;
+        return shamir_share_batch(field, values, t, n, dealer);
+    }
+
+    /*  Shares of a + c for public c: every share moves by c  */
+    vector<vector<uint64_t>> add_constant(const vector<vector<uint64_t>>& a, const vector<uint64_t>& c) const
+    {
+        vector<vector<uint64_t>> result(a);
+        for (int i = 0; i < n; i++)
+        {
+            for (size_t k = 0; k < result[i].size(); k++)
+            {
+                result[i][k] = field.add(result[i][k], c[k]);
+            }
+        }
+        return result;
+    }
+
+    vector<vector<uint64_t>> scale(const vector<vector<uint64_t>>& a, uint64_t c) const
+    {
+        vector<vector<uint64_t>> result(a);
+        for (int i = 0; i < n; i++)
+        {
+            for (uint64_t& share : result[i])
+            {
+                share = field.mul(share, c);
+            }
+        }
+        return result;
+    }
+
+    vector<vector<uint64_t>> subtract(const vector<vector<uint64_t>>& a, const vector<vector<uint64_t>>& b) const
+    {
+        vector<vector<uint64_t>> result(a);
+        for (int i = 0; i < n; i++)
+        {
+            for (size_t k = 0; k < result[i].size(); k++)
+            {
+                result[i][k] = field.sub(result[i][k], b[i][k]);
+            }
+        }
+        return result;
+    }
+
+    /*  Batches laid end to end, so independent products share one round  */
+    vector<vector<uint64_t>> concat(const vector<const vector<vector<uint64_t>>*>& parts) const
+    {
+        vector<vector<uint64_t>> result(n);
+        for (int i = 0; i < n; i++)
+        {
+            for (const vector<vector<uint64_t>>* part : parts)
+            {
+                result[i].insert(result[i].end(), (*part)[i].begin(), (*part)[i].end());
+            }
+        }
+        return result;
+    }
+
+    vector<vector<uint64_t>> slice(const vector<vector<uint64_t>>& a, size_t offset, size_t length) const
+    {
+        vector<vector<uint64_t>> result(n);
+        for (int i = 0; i < n; i++)
+        {
+            result[i].assign(a[i].begin() + offset, a[i].begin() + offset + length);
+        }
+        return result;
+    }
+
+    /*  [c < r] for public m-bit c[k] and shared bits r_bits[j] (bit j of every value, LSB first).
+     *  Bit j contributes (e, v) = ([c_j == r_j], [c_j < r_j]), both linear in r_j since c_j is public.
+     *  Combining a higher half H with a lower half L gives (e_H e_L, v_H + e_H v_L), which is associative,
+     *  so the m bits reduce in ceil(log2 m) rounds, each one multiplication of the whole level.  */
+    vector<vector<uint64_t>> bit_less_than(const vector<uint64_t>& c, const vector<vector<vector<uint64_t>>>& r_bits)
+    {
+        size_t batch = c.size();
+        vector<vector<vector<uint64_t>>> e, v;
+        for (size_t j = 0; j < r_bits.size(); j++)
+        {
+            vector<vector<uint64_t>> e_j(n, vector<uint64_t>(batch)), v_j(n, vector<uint64_t>(batch));
+            for (int i = 0; i < n; i++)
+            {
+                for (size_t k = 0; k < batch; k++)
+                {
+                    uint64_t r = r_bits[j][i][k];
+                    bool c_j = (c[k] >> j) & 1;
+                    e_j[i][k] = c_j ? r : field.sub(1, r);
+                    v_j[i][k] = c_j ? 0 : r;
+                }
+            }
+            e.push_back(std::move(e_j));
+            v.push_back(std::move(v_j));
+        }
+
+        while (e.size() > 1)
+        {
+            size_t pairs = e.size() / 2;
+            vector<const vector<vector<uint64_t>>*> left, right;
+            for (size_t p = 0; p < pairs; p++)
+            {
+                left.push_back(&e[2 * p + 1]);
+                right.push_back(&e[2 * p]);
+            }
+            for (size_t p = 0; p < pairs; p++)
+            {
+                left.push_back(&e[2 * p + 1]);
+                right.push_back(&v[2 * p]);
+            }
+            vector<vector<uint64_t>> products = network.multiply(concat(left), concat(right));
+
+            vector<vector<vector<uint64_t>>> next_e, next_v;
+            for (size_t p = 0; p < pairs; p++)
+            {
+                next_e.push_back(slice(products, p * batch, batch));
+                next_v.push_back(network.add(v[2 * p + 1], slice(products, (pairs + p) * batch, batch)));
+            }
+            if (e.size() % 2)
+            {
+                next_e.push_back(std::move(e.back()));
+                next_v.push_back(std::move(v.back()));
+            }
+            e.swap(next_e);
+            v.swap(next_v);
+        }
+        return v[0];
+    }
+
+public:
+    BGW_fixed_point(BGW_network& network_, int fraction_bits_, int value_bits_, int security_bits_, uint64_t seed)
+        : network(network_), field(network_.get_field()), n(network_.get_num_of_parties()),
+          t(network_.get_threshold()), fraction_bits(fraction_bits_), value_bits(value_bits_),
+          security_bits(security_bits_), dealer(seed)
+    {
+        if (value_bits + security_bits + 1 >= log2((double)field.prime()))
+        {
+            throw invalid_argument("BGW_fixed_point: the field must hold value_bits + security_bits + 1 bits");
+        }
+        if (2 * fraction_bits >= value_bits - 1)
+        {
+            throw invalid_argument("BGW_fixed_point: no room for a product of two fixed-point values");
+        }
+    }
+
+    int get_fraction_bits() const
+    {
+        return fraction_bits;
+    }
+
+    size_t get_rounds() const
+    {
+        return network.get_rounds();
+    }
+
+    size_t get_preprocessing_elements() const
+    {
+        return preprocessing_elements;
+    }
+
+    uint64_t encode(double value) const
+    {
+        return field.from_signed(llround(value * pow(2.0, fraction_bits)));
+    }
+
+    double decode(uint64_t element) const
+    {
+        return (double)field.to_signed(element) / pow(2.0, fraction_bits);
+    }
+
+    vector<vector<uint64_t>> share(const vector<double>& values, mt19937_64& gen) const
+    {
+        vector<uint64_t> encoded;
+        for (double value : values)
+        {
+            encoded.push_back(encode(value));
+        }
+        return shamir_share_batch(field, encoded, t, n, gen);
+    }
+
+    /*  One round: every party sends its shares to every other party and interpolates at 0  */
+    vector<uint64_t> open(const vector<vector<uint64_t>>& a)
+    {
+        size_t batch = a[0].size();
+        const vector<uint64_t>& recombination = network.get_recombination_vector();
+        vector<uint64_t> opened;
+
+        network.run_parties([&](int i) {
+            vector<vector<uint64_t>> incoming = network.exchange(i, vector<vector<uint64_t>>(n, a[i]));
+            vector<uint64_t> values(batch, 0);
+            for (int from = 0; from < n; from++)
+            {
+                for (size_t k = 0; k < batch; k++)
+                {
+                    values[k] = field.add(values[k], field.mul(recombination[from], incoming[from][k]));
+                }
+            }
+            if (i == 0)
+            {
+                opened = std::move(values);
+            }
+        });
+
+        network.record_round(batch);
+        return opened;
+    }
+
+    vector<double> open_fixed(const vector<vector<uint64_t>>& a)
+    {
+        vector<double> values;
+        for (uint64_t element : open(a))
+        {
+            values.push_back(decode(element));
+        }
+        return values;
+    }
+
+    /*  a / 2^m rounded up or down at random (probabilistic truncation), one round  */
+    vector<vector<uint64_t>> truncate(const vector<vector<uint64_t>>& a, int m)
+    {
+        if (m < 1 || m >= value_bits)
+        {
+            throw invalid_argument("truncate: the shift must be within the value bits");
+        }
+        size_t batch = a[0].size();
+        uint64_t high_bound = 1ULL << (value_bits + security_bits - m);
+        vector<uint64_t> r(batch), r_high(batch);
+        for (size_t k = 0; k < batch; k++)
+        {
+            r_high[k] = dealer() % high_bound;
+            r[k] = (r_high[k] << m) + dealer() % (1ULL << m);
+        }
+        vector<vector<uint64_t>> r_shares = deal(r);
+        vector<vector<uint64_t>> r_high_shares = deal(r_high);
+
+        vector<uint64_t> offset(batch, power_of_two(value_bits - 1));
+        vector<uint64_t> c = open(network.add(add_constant(a, offset), r_shares));
+
+        vector<uint64_t> shifted(batch);
+        for (size_t k = 0; k < batch; k++)
+        {
+            shifted[k] = field.sub(c[k] >> m, power_of_two(value_bits - 1 - m));
+        }
+        return add_constant(scale(r_high_shares, field.neg(1)), shifted);
+    }
+
+    /*  Shares of the bits [a < 0] (as 0/1 field elements, not fixed point)  */
+    vector<vector<uint64_t>> less_than_zero(const vector<vector<uint64_t>>& a)
+    {
+        size_t batch = a[0].size();
+        int m = value_bits - 1;
+        uint64_t high_bound = 1ULL << (value_bits + security_bits - m);
+
+        /*  Preprocessing: r = r_high 2^m + sum_j r_j 2^j with every bit r_j shared  */
+        vector<vector<vector<uint64_t>>> r_bits;
+        vector<vector<uint64_t>> r_low_shares(n, vector<uint64_t>(batch, 0));
+        for (int j = 0; j < m; j++)
+        {
+            vector<uint64_t> bits(batch);
+            for (size_t k = 0; k < batch; k++)
+            {
+                bits[k] = dealer() & 1;
+            }
+            r_bits.push_back(deal(bits));
+            r_low_shares = network.add(r_low_shares, scale(r_bits.back(), power_of_two(j)));
+        }
+        vector<uint64_t> r_high(batch);
+        for (size_t k = 0; k < batch; k++)
+        {
+            r_high[k] = dealer() % high_bound;
+        }
+        vector<vector<uint64_t>> r_shares = network.add(scale(deal(r_high), power_of_two(m)), r_low_shares);
+
+        vector<uint64_t> offset(batch, power_of_two(value_bits - 1));
+        vector<uint64_t> c = open(network.add(add_constant(a, offset), r_shares));
+        vector<uint64_t> c_low(batch);
+        for (size_t k = 0; k < batch; k++)
+        {
+            c_low[k] = c[k] & ((1ULL << m) - 1);
+        }
+
+        /*  a mod 2^m = c' - r' + 2^m [c' < r'];  [a < 0] = (a mod 2^m - a) / 2^m  */
+        vector<vector<uint64_t>> a_mod = add_constant(
+            subtract(scale(bit_less_than(c_low, r_bits), power_of_two(m)), r_low_shares), c_low);
+        return scale(subtract(a_mod, a), field.inv(power_of_two(m)));
+    }
+
+    /*  [a < b] as 0/1 shares  */
+    vector<vector<uint64_t>> less_than(const vector<vector<uint64_t>>& a, const vector<vector<uint64_t>>& b)
+    {
+        return less_than_zero(subtract(a, b));
+    }
+
+    vector<vector<uint64_t>> add(const vector<vector<uint64_t>>& a, const vector<vector<uint64_t>>& b) const
+    {
+        return network.add(a, b);
+    }
+
+    vector<vector<uint64_t>> negate(const vector<vector<uint64_t>>& a) const
+    {
+        return scale(a, field.neg(1));
+    }
+
+    vector<vector<uint64_t>> add_public(const vector<vector<uint64_t>>& a, double c) const
+    {
+        return add_constant(a, vector<uint64_t>(a[0].size(), encode(c)));
+    }
+
+    /*  Fixed-point product: BGW multiplication, then truncation by f (two rounds)  */
+    vector<vector<uint64_t>> multiply(const vector<vector<uint64_t>>& a, const vector<vector<uint64_t>>& b)
+    {
+        return truncate(network.multiply(a, b), fraction_bits);
+    }
+
+    /*  a c for public c: local, then one truncation. Small constants (1/U_max) are encoded with extra
+     *  fraction bits so they keep f significant bits.  */
+    vector<vector<uint64_t>> multiply_public(const vector<vector<uint64_t>>& a, double c)
+    {
+        if (c == 0)
+        {
+            return vector<vector<uint64_t>>(n, vector<uint64_t>(a[0].size(), 0));
+        }
+        int extra_bits = max(0, (int)ceil(-log2(std::abs(c))));
+        int constant_bits = fraction_bits + extra_bits;
+        return truncate(scale(a, field.from_signed(llround(c * pow(2.0, constant_bits)))), constant_bits);
+    }
+
+    /*  hi / x for x in [plan.lo, plan.hi]: 2 rounds for u and y0, 4 per Newton step  */
+    vector<vector<uint64_t>> reciprocal(const vector<vector<uint64_t>>& x, const Newton_Plan& plan)
+    {
+        if (plan.inverse_sqrt)
+        {
+            throw invalid_argument("reciprocal: the plan is for the inverse square root");
+        }
+        vector<vector<uint64_t>> u = multiply_public(x, 1 / plan.hi);
+        vector<vector<uint64_t>> y = add_public(multiply_public(u, plan.b), plan.a);
+        for (size_t i = 0; i < plan.iterations; i++)
+        {
+            vector<vector<uint64_t>> u_y_square = multiply(multiply(u, y), y);
+            y = subtract(network.add(y, y), u_y_square);
+        }
+        return y;
+    }
+
+    /*  sqrt(hi / x) for x in [plan.lo, plan.hi]: 2 rounds for -u/2 and y0, 5 per Newton step
+     *  (y^2 and -u y / 2 share a round)  */
+    vector<vector<uint64_t>> inverse_sqrt(const vector<vector<uint64_t>>& x, const Newton_Plan& plan)
+    {
+        if (!plan.inverse_sqrt)
+        {
+            throw invalid_argument("inverse_sqrt: the plan is for the reciprocal");
+        }
+        size_t batch = x[0].size();
+        vector<vector<uint64_t>> minus_half_u = multiply_public(x, -0.5 / plan.hi);
+        vector<vector<uint64_t>> y = add_public(multiply_public(x, plan.b / plan.hi), plan.a);
+        for (size_t i = 0; i < plan.iterations; i++)
+        {
+            vector<vector<uint64_t>> products = multiply(concat({&y, &minus_half_u}), concat({&y, &y}));
+            vector<vector<uint64_t>> y_square = slice(products, 0, batch);
+            vector<vector<uint64_t>> minus_half_u_y = slice(products, batch, batch);
+            vector<vector<uint64_t>> one_and_half_y = multiply_public(y, 1.5);
+            y = network.add(one_and_half_y, multiply(minus_half_u_y, y_square));
+        }
+        return y;
+    }
+};
+
+#endif // SEAL_BGW_FIXED_POINT_H
@@ -2,7 +2,10 @@
 // Created by Anat Samohi on 22/12/2020.
 //
 
+#include <chrono>
 #include "BGW_client.h"
+#include "BGW_fixed_point.h"
+#include "BGW_multiplication.h"
 #include "../CKKS_based/real_values_simulation.h"
 
 void Logrank_BGW_protocol_sim (int test_index) {
@@ -38,8 +41,181 @@ void Logrank_BGW_protocol_sim (int test_index) {
     int prime_size  = client1.get_prime_size(Lmax, 5);
     std::cout << " prime_size: " << prime_size << std::endl;
 
-    //use field 42b
-    long long int prime = 2871385470517; //42b
+    /*  get_prime_size covers integer inputs and the products with R. O-E and V are fixed point with
+     *  fraction_bits binary digits, so the field grows by that much; r only masks and is rounded to an integer.
+     *  (The 42-bit prime 2871385470517 fits prime_size for integer inputs only.)  */
+    const int fraction_bits = 12;
+    long long int prime = find_prime(prime_size + fraction_bits);
+    std::cout << " prime: " << prime << " (" << prime_size + fraction_bits << " bits)" << std::endl;
 
+    BGW_client* clients[5] = {&client1, &client2, &client3, &client4, &client5};
+    double inputs_O_minus_E[5] = {inputs.O1 - inputs.E1, inputs.O2 - inputs.E2, inputs.O3 - inputs.E3,
+                                  inputs.O4 - inputs.E4, inputs.O5 - inputs.E5};
+    double inputs_V[5] = {inputs.V1, inputs.V2, inputs.V3, inputs.V4, inputs.V5};
+    double inputs_r[5] = {inputs.r1, inputs.r2, inputs.r3, inputs.r4, inputs.r5};
 
-}
\ No newline at end of file
+    /*  The five clients are the five parties. t = 2, so any three reconstruct and 2t < 5 allows multiplication  */
+    const int n = 5, t = 2;
+    Prime_Field field(prime);
+    BGW_network network(field, n, t, time(NULL));
+    mt19937_64 gen(time(NULL) + 1);
+
+    /*  1. Every client shares (O-E, V, r) as one batch: shares[i][k] is party i's share of value k  */
+    vector<vector<uint64_t>> T_shares(n, vector<uint64_t>(2, 0));
+    vector<vector<uint64_t>> R_shares(n, vector<uint64_t>(2, 0));
+    for (int c = 0; c < n; c++)
+    {
+        clients[c]->set_prime(prime);
+        long long int scale = 1LL << fraction_bits;
+        vector<uint64_t> values = {field.from_signed(llround(inputs_O_minus_E[c] * scale)),
+                                   field.from_signed(llround(inputs_V[c] * scale)),
+                                   field.from_signed(max(1LL, llround(inputs_r[c])))};
+        vector<vector<uint64_t>> shares = shamir_share_batch(field, values, t, n, gen);
+
+        /*  2. Local sums: T0 = sigma(O-E), T1 = sigma(V), R = sigma(r), laid out as batches [T0, T1] and [R, R]  */
+        for (int i = 0; i < n; i++)
+        {
+            T_shares[i][0] = field.add(T_shares[i][0], shares[i][0]);
+            T_shares[i][1] = field.add(T_shares[i][1], shares[i][1]);
+            R_shares[i][0] = field.add(R_shares[i][0], shares[i][2]);
+            R_shares[i][1] = field.add(R_shares[i][1], shares[i][2]);
+        }
+    }
+
+    /*  3. Two rounds of BGW multiplication: [T0 R, T1 R], then U = (T1 R) R  */
+    chrono::high_resolution_clock::time_point time_start = chrono::high_resolution_clock::now();
+    vector<vector<uint64_t>> products = network.multiply(T_shares, R_shares);
+    vector<vector<uint64_t>> U_left(n), R_right(n);
+    for (int i = 0; i < n; i++)
+    {
+        U_left[i] = {products[i][1]};
+        R_right[i] = {R_shares[i][1]};
+    }
+    vector<vector<uint64_t>> U_shares = network.multiply(U_left, R_right);
+    chrono::microseconds mult_time =
+        chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - time_start);
+
+    /*  4. Any t+1 parties open D and U  */
+    vector<vector<uint64_t>> D_shares(n);
+    for (int i = 0; i < n; i++)
+    {
+        D_shares[i] = {products[i][0]};
+    }
+    double D = (double)field.to_signed(shamir_reconstruct_batch(field, D_shares, {0, 1, 2})[0]) / (1LL << fraction_bits);
+    double U = (double)field.to_signed(shamir_reconstruct_batch(field, U_shares, {2, 3, 4})[0]) / (1LL << fraction_bits);
+    double Z = D / sqrt(U);
+
+    std::cout << " BGW Z: " << Z << " (" << network.get_rounds() << " multiplication rounds, "
+              << network.get_elements_sent() << " field elements sent, " << mult_time.count() << " us)" << std::endl;
+    if (std::abs((Z - trueResult) / trueResult) > 0.001)
+    {
+        std::cout << "---- ERROR!! ----- the gap is : " << std::abs((Z - trueResult) / trueResult) << std::endl;
+        throw;
+    }
+}
+
+/*  Z = D / sqrt(U) and the Peto log hazard ratio D / U computed on shares, so only Z, log HR and the
+ *  significance bit [|Z| > 1.96] are opened - not D and U. The public range [U_min, U_max] of U comes
+ *  from the study design, as for the CKKS inverse square root.  */
+void Logrank_BGW_z_sim(int test_index, double U_min, double U_max)
+{
+    Inputs5Clients inputs = take_inputs_from_data(test_index);
+    double inputs_O_minus_E[5] = {inputs.O1 - inputs.E1, inputs.O2 - inputs.E2, inputs.O3 - inputs.E3,
+                                  inputs.O4 - inputs.E4, inputs.O5 - inputs.E5};
+    double inputs_V[5] = {inputs.V1, inputs.V2, inputs.V3, inputs.V4, inputs.V5};
+
+    double sigma_D = 0, sigma_U = 0;
+    for (int c = 0; c < 5; c++)
+    {
+        sigma_D += inputs_O_minus_E[c];
+        sigma_U += inputs_V[c];
+    }
+    double true_Z = sigma_D / sqrt(sigma_U);
+    double true_log_HR = sigma_D / sigma_U;
+    std::cout << " True Z: " << true_Z << ", true log HR: " << true_log_HR << std::endl;
+
+    const int n = 5, t = 2;
+    Prime_Field field(FIXED_POINT_PRIME);
+    BGW_network network(field, n, t, time(NULL));
+    BGW_fixed_point fixed_point(network, 16, 43, 16, time(NULL) + 1);
+    mt19937_64 gen(time(NULL) + 2);
+
+    /*  1. Every client shares (O-E, V); the sums are local  */
+    vector<vector<uint64_t>> D(n, vector<uint64_t>(1, 0)), U(n, vector<uint64_t>(1, 0));
+    for (int c = 0; c < n; c++)
+    {
+        vector<vector<uint64_t>> shares = fixed_point.share({inputs_O_minus_E[c], inputs_V[c]}, gen);
+        for (int i = 0; i < n; i++)
+        {
+            D[i][0] = field.add(D[i][0], shares[i][0]);
+            U[i][0] = field.add(U[i][0], shares[i][1]);
+        }
+    }
+
+    Newton_Plan inverse_sqrt_plan = plan_newton(true, U_min, U_max, 1e-5, 20);
+    Newton_Plan reciprocal_plan = plan_newton(false, U_min, U_max, 1e-5, 20);
+
+    /*  2. Z = (D / sqrt(U_max)) sqrt(U_max / U)  */
+    chrono::high_resolution_clock::time_point time_start = chrono::high_resolution_clock::now();
+    vector<vector<uint64_t>> Z = fixed_point.multiply(fixed_point.multiply_public(D, 1 / sqrt(U_max)),
+                                                      fixed_point.inverse_sqrt(U, inverse_sqrt_plan));
+    size_t z_rounds = fixed_point.get_rounds();
+    chrono::microseconds z_time =
+        chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - time_start);
+
+    /*  3. log HR = (D / U_max) (U_max / U)  */
+    time_start = chrono::high_resolution_clock::now();
+    vector<vector<uint64_t>> log_HR = fixed_point.multiply(fixed_point.multiply_public(D, 1 / U_max),
+                                                           fixed_point.reciprocal(U, reciprocal_plan));
+    size_t log_HR_rounds = fixed_point.get_rounds() - z_rounds;
+    chrono::microseconds log_HR_time =
+        chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - time_start);
+
+    /*  4. [Z < -1.96] + [-Z < -1.96], both comparisons in one batch  */
+    time_start = chrono::high_resolution_clock::now();
+    vector<vector<uint64_t>> Z_low = fixed_point.add_public(Z, 1.96);
+    vector<vector<uint64_t>> Z_high = fixed_point.add_public(fixed_point.negate(Z), 1.96);
+    vector<vector<uint64_t>> both(n);
+    for (int i = 0; i < n; i++)
+    {
+        both[i] = {Z_low[i][0], Z_high[i][0]};
+    }
+    vector<vector<uint64_t>> tails = fixed_point.less_than_zero(both);
+    vector<vector<uint64_t>> significant(n);
+    for (int i = 0; i < n; i++)
+    {
+        significant[i] = {field.add(tails[i][0], tails[i][1])};
+    }
+    size_t comparison_rounds = fixed_point.get_rounds() - z_rounds - log_HR_rounds;
+    chrono::microseconds comparison_time =
+        chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - time_start);
+
+    double opened_Z = fixed_point.open_fixed(Z)[0];
+    double opened_log_HR = fixed_point.open_fixed(log_HR)[0];
+    uint64_t opened_significant = fixed_point.open(significant)[0];
+
+    std::cout << " BGW Z: " << opened_Z << " (" << inverse_sqrt_plan.iterations << " Newton steps, " << z_rounds
+              << " rounds, " << z_time.count() << " us)" << std::endl;
+    std::cout << " BGW log HR: " << opened_log_HR << " (" << reciprocal_plan.iterations << " Newton steps, "
+              << log_HR_rounds << " rounds, " << log_HR_time.count() << " us)" << std::endl;
+    std::cout << " BGW |Z| > 1.96: " << opened_significant << " (" << comparison_rounds << " rounds, "
+              << comparison_time.count() << " us)" << std::endl;
+    std::cout << " Preprocessing: " << fixed_point.get_preprocessing_elements() << " dealer share elements, "
+              << network.get_elements_sent() << " field elements sent online" << std::endl;
+
+    if (std::abs((opened_Z - true_Z) / true_Z) > 0.001 || std::abs(opened_log_HR - true_log_HR) > 0.001 ||
+        opened_significant != (std::abs(true_Z) > 1.96 ? 1u : 0u))
+    {
+        std::cout << "---- ERROR!! ----- the shared Z, log HR or significance bit is off" << std::endl;
+        throw;
+    }
+}
+
+void example_bgw_fixed_point_test()
+{
+    /*  Five sites of the Mainz cohort: U is around 11, the design range [4, 64] leaves room either way  */
+    for (int test_index = 0; test_index < 5; test_index++)
+    {
+        Logrank_BGW_z_sim(test_index, 4, 64);
+    }
+}
@@ -0,0 +1,215 @@
+//
+// BGW multiplication of Shamir shares with degree reduction, n parties as threads.
+//
+
+#ifndef SEAL_BGW_MULTIPLICATION_H
+#define SEAL_BGW_MULTIPLICATION_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "BGW_shamir.h"
+
+/*  The inbox of one party: one buffer per sender for the current round.
+ *  receive_all() blocks until every sender delivered, then empties the inbox for the next round.  */
+class BGW_mailbox
+{
+private:
+    std::mutex mutex;
+    std::condition_variable arrived;
+    vector<vector<uint64_t>> buffers;
+    int pending;
+
+public:
+    explicit BGW_mailbox(int n) : buffers(n), pending(n) {}
+
+    void send(int from, vector<uint64_t>&& buffer)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        buffers[from] = std::move(buffer);
+        if (--pending == 0)
+        {
+            arrived.notify_one();
+        }
+    }
+
+    vector<vector<uint64_t>> receive_all()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        arrived.wait(lock, [this]() { return pending == 0; });
+        vector<vector<uint64_t>> received(buffers.size());
+        received.swap(buffers);
+        pending = (int)received.size();
+        return received;
+    }
+};
+
+/*  n parties with threshold t (2t < n, so the degree-2t product is still determined by the n shares).
+ *  A multiplication of two shared batches is one round:
+ *      1. party i multiplies its shares locally: h_i = a_i * b_i  (a degree-2t sharing of a*b)
+ *      2. party i reshares every h_i with a fresh degree-t polynomial and sends party j its sub-shares
+ *         for the whole batch in a single buffer
+ *      3. party j recombines: c_j = sum_i lambda_i * subshare_{i->j}, lambda the recombination vector of
+ *         the points 1..n at 0 (precomputed once - for n = 5 it is BGW_client::lamda)
+ *  c is a degree-t sharing of a*b. Every party is a thread; the buffers travel through in-memory mailboxes.  */
+class BGW_network
+{
+private:
+    Prime_Field field;
+    int n;
+    int t;
+    vector<uint64_t> recombination;
+    vector<BGW_mailbox*> mailboxes;
+    vector<mt19937_64> party_rng;
+    size_t rounds = 0;
+    size_t elements_sent = 0;
+
+public:
+    BGW_network(const Prime_Field& field_, int n_, int t_, uint64_t seed) : field(field_), n(n_), t(t_)
+    {
+        if (2 * t >= n)
+        {
+            throw invalid_argument("BGW_network: multiplication needs 2t < n");
+        }
+        vector<uint64_t> xs;
+        for (int i = 0; i < n; i++)
+        {
+            xs.push_back(i + 1);
+            mailboxes.push_back(new BGW_mailbox(n));
+            party_rng.emplace_back(seed + i);
+        }
+        recombination = lagrange_at_zero(field, xs);
+    }
+
+    ~BGW_network()
+    {
+        for (BGW_mailbox* mailbox : mailboxes)
+        {
+            delete mailbox;
+        }
+    }
+
+    BGW_network(const BGW_network&) = delete;
+    BGW_network& operator=(const BGW_network&) = delete;
+
+    const Prime_Field& get_field() const
+    {
+        return field;
+    }
+
+    int get_num_of_parties() const
+    {
+        return n;
+    }
+
+    int get_threshold() const
+    {
+        return t;
+    }
+
+    size_t get_rounds() const
+    {
+        return rounds;
+    }
+
+    size_t get_elements_sent() const
+    {
+        return elements_sent;
+    }
+
+    /*  The private randomness of party i, for protocols built on top of the network  */
+    mt19937_64& get_party_rng(int i)
+    {
+        return party_rng[i];
+    }
+
+    const vector<uint64_t>& get_recombination_vector() const
+    {
+        return recombination;
+    }
+
+    /*  Run party_code(i) for every party i on its own thread and wait for all of them  */
+    void run_parties(const std::function<void(int)>& party_code)
+    {
+        vector<thread> parties;
+        for (int i = 0; i < n; i++)
+        {
+            parties.emplace_back(party_code, i);
+        }
+        for (thread& party : parties)
+        {
+            party.join();
+        }
+    }
+
+    /*  Called by party `from` inside run_parties: send outgoing[j] to every party j, then wait for the
+     *  buffers of the round addressed to `from` (indexed by sender)  */
+    vector<vector<uint64_t>> exchange(int from, vector<vector<uint64_t>>&& outgoing)
+    {
+        for (int j = 0; j < n; j++)
+        {
+            mailboxes[j]->send(from, std::move(outgoing[j]));
+        }
+        return mailboxes[from]->receive_all();
+    }
+
+    /*  Traffic accounting, called once per round after run_parties returns  */
+    void record_round(size_t elements_per_party_pair)
+    {
+        rounds++;
+        elements_sent += (size_t)n * (n - 1) * elements_per_party_pair;
+    }
+
+    /*  Local linear operations need no communication  */
+    vector<vector<uint64_t>> add(const vector<vector<uint64_t>>& a, const vector<vector<uint64_t>>& b) const
+    {
+        vector<vector<uint64_t>> c(a);
+        for (int i = 0; i < n; i++)
+        {
+            for (size_t k = 0; k < c[i].size(); k++)
+            {
+                c[i][k] = field.add(c[i][k], b[i][k]);
+            }
+        }
+        return c;
+    }
+
+    /*  shares[i][k] - party i's share of the k-th value of the batch  */
+    vector<vector<uint64_t>> multiply(const vector<vector<uint64_t>>& a, const vector<vector<uint64_t>>& b)
+    {
+        size_t batch = a[0].size();
+        vector<vector<uint64_t>> c(n);
+
+        run_parties([&](int i) {
+            /*  1. Local product, a degree-2t sharing  */
+            vector<uint64_t> h(batch);
+            for (size_t k = 0; k < batch; k++)
+            {
+                h[k] = field.mul(a[i][k], b[i][k]);
+            }
+
+            /*  2. Reshare the whole batch at degree t, one buffer per recipient  */
+            vector<vector<uint64_t>> incoming = exchange(i, shamir_share_batch(field, h, t, n, party_rng[i]));
+
+            /*  3. Recombine the sub-shares from every party  */
+            vector<uint64_t> result(batch, 0);
+            for (int from = 0; from < n; from++)
+            {
+                uint64_t lambda = recombination[from];
+                const vector<uint64_t>& subshares = incoming[from];
+                for (size_t k = 0; k < batch; k++)
+                {
+                    result[k] = field.add(result[k], field.mul(lambda, subshares[k]));
+                }
+            }
+            c[i] = std::move(result);
+        });
+
+        record_round(batch);
+        return c;
+    }
+};
+
+#endif // SEAL_BGW_MULTIPLICATION_H
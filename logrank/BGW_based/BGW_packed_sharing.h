@@ -0,0 +1,194 @@
+//
+// Packed (Franklin-Yung) secret sharing over the BGW network: one polynomial carries k secrets.
+//
+
+#ifndef SEAL_BGW_PACKED_SHARING_H
+#define SEAL_BGW_PACKED_SHARING_H
+
+#include <vector>
+#include "BGW_multiplication.h"
+#include "BGW_shamir.h"
+
+/*  A block of k secrets s_1..s_k is shared with one polynomial f of degree d = t + k - 1:
+ *      f(-j) = s_j            j = 1..k       (the secret points)
+ *      f(-(k + r)) random     r = 1..t       (t random points hide the secrets from any t parties)
+ *  and party i (0-based) holds f(i + 1) as in BGW_shamir.h. Every party therefore holds one element per
+ *  block instead of one per value, and every round moves 1/k of the elements of plain Shamir.
+ *  Addition stays local. A multiplication gives a degree-2d sharing of the slot-wise product, so it needs
+ *  2d < n, i.e. n >= 2(t + k - 1) + 1; degree reduction is one round:
+ *      1. party i multiplies locally: h_i = a_i * b_i
+ *      2. party i packs (L_i(-1) h_i, ..., L_i(-k) h_i) at degree d and sends party j its sub-share,
+ *         L_i the Lagrange basis of the points 1..n
+ *      3. party j adds the sub-shares: sum_i L_i(-j) h_i = h(-j) = a_j b_j in every slot j
+ *  Blocks are padded with zeros, so a batch of any size can be shared.  */
+class Packed_BGW
+{
+private:
+    BGW_network& network;
+    Prime_Field field;
+    int n;
+    int t;
+    int k;
+    int degree;
+    vector<uint64_t> secret_points;
+    /*  share_matrix[i][m] - weight of the m-th interpolation point (k secrets, then t random values) in the
+     *  share of party i; reduction[i][j] = L_i(-(j + 1))  */
+    vector<vector<uint64_t>> share_matrix;
+    vector<vector<uint64_t>> reduction;
+
+public:
+    Packed_BGW(BGW_network& network_, int k_)
+        : network(network_), field(network_.get_field()), n(network_.get_num_of_parties()),
+          t(network_.get_threshold()), k(k_), degree(t + k_ - 1)
+    {
+        if (k < 1 || 2 * degree >= n)
+        {
+            throw invalid_argument("Packed_BGW: multiplication needs 2(t + k - 1) < n");
+        }
+
+        vector<uint64_t> interpolation_points;
+        for (int m = 1; m <= k + t; m++)
+        {
+            interpolation_points.push_back(field.neg(m));
+        }
+        secret_points.assign(interpolation_points.begin(), interpolation_points.begin() + k);
+
+        vector<uint64_t> party_points;
+        for (int i = 0; i < n; i++)
+        {
+            party_points.push_back(i + 1);
+            share_matrix.push_back(lagrange_at(field, interpolation_points, i + 1));
+        }
+
+        reduction.assign(n, vector<uint64_t>(k));
+        for (int j = 0; j < k; j++)
+        {
+            vector<uint64_t> basis = lagrange_at(field, party_points, secret_points[j]);
+            for (int i = 0; i < n; i++)
+            {
+                reduction[i][j] = basis[i];
+            }
+        }
+    }
+
+    int get_pack_size() const
+    {
+        return k;
+    }
+
+    int get_degree() const
+    {
+        return degree;
+    }
+
+    size_t get_num_of_blocks(size_t count) const
+    {
+        return (count + k - 1) / k;
+    }
+
+    /*  shares[i][b] - party i's share of block b, i.e. of values[b*k .. b*k + k-1]  */
+    vector<vector<uint64_t>> share_batch(const vector<uint64_t>& values, mt19937_64& gen) const
+    {
+        size_t blocks = get_num_of_blocks(values.size());
+        vector<vector<uint64_t>> shares(n, vector<uint64_t>(blocks));
+        vector<uint64_t> point_values(k + t);
+        for (size_t b = 0; b < blocks; b++)
+        {
+            for (int j = 0; j < k; j++)
+            {
+                size_t index = b * k + j;
+                point_values[j] = (index < values.size()) ? values[index] : 0;
+            }
+            for (int r = 0; r < t; r++)
+            {
+                point_values[k + r] = field.random(gen);
+            }
+            for (int i = 0; i < n; i++)
+            {
+                uint64_t y = 0;
+                for (int m = 0; m < k + t; m++)
+                {
+                    y = field.add(y, field.mul(share_matrix[i][m], point_values[m]));
+                }
+                shares[i][b] = y;
+            }
+        }
+        return shares;
+    }
+
+    /*  The first `count` values, from the shares of at least degree+1 parties (0-based)  */
+    vector<uint64_t> reconstruct_batch(const vector<vector<uint64_t>>& shares, const vector<int>& parties,
+                                       size_t count) const
+    {
+        if ((int)parties.size() <= degree)
+        {
+            throw invalid_argument("Packed_BGW: reconstruction needs degree + 1 parties");
+        }
+        vector<uint64_t> xs;
+        for (int party : parties)
+        {
+            xs.push_back(party + 1);
+        }
+        vector<vector<uint64_t>> basis;
+        for (int j = 0; j < k; j++)
+        {
+            basis.push_back(lagrange_at(field, xs, secret_points[j]));
+        }
+
+        vector<uint64_t> values(count, 0);
+        for (size_t index = 0; index < count; index++)
+        {
+            size_t b = index / k;
+            const vector<uint64_t>& lambda = basis[index % k];
+            for (size_t i = 0; i < parties.size(); i++)
+            {
+                values[index] = field.add(values[index], field.mul(lambda[i], shares[parties[i]][b]));
+            }
+        }
+        return values;
+    }
+
+    vector<vector<uint64_t>> add(const vector<vector<uint64_t>>& a, const vector<vector<uint64_t>>& b) const
+    {
+        return network.add(a, b);
+    }
+
+    /*  Slot-wise product of two packed batches, one round  */
+    vector<vector<uint64_t>> multiply(const vector<vector<uint64_t>>& a, const vector<vector<uint64_t>>& b)
+    {
+        size_t blocks = a[0].size();
+        vector<vector<uint64_t>> c(n);
+
+        network.run_parties([&](int i) {
+            /*  1. Local product, a degree-2d packed sharing  */
+            vector<uint64_t> weighted(blocks * k);
+            for (size_t blk = 0; blk < blocks; blk++)
+            {
+                uint64_t h = field.mul(a[i][blk], b[i][blk]);
+                for (int j = 0; j < k; j++)
+                {
+                    weighted[blk * k + j] = field.mul(reduction[i][j], h);
+                }
+            }
+
+            /*  2. Repack at degree d, one element per block for every recipient  */
+            vector<vector<uint64_t>> incoming = network.exchange(i, share_batch(weighted, network.get_party_rng(i)));
+
+            /*  3. The sub-shares add up to the degree-d sharing of the products  */
+            vector<uint64_t> result(blocks, 0);
+            for (int from = 0; from < n; from++)
+            {
+                for (size_t blk = 0; blk < blocks; blk++)
+                {
+                    result[blk] = field.add(result[blk], incoming[from][blk]);
+                }
+            }
+            c[i] = std::move(result);
+        });
+
+        network.record_round(blocks);
+        return c;
+    }
+};
+
+#endif // SEAL_BGW_PACKED_SHARING_H
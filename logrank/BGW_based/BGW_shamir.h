@@ -0,0 +1,246 @@
+//
+// Prime field arithmetic and Shamir secret sharing for the BGW protocol.
+//
+
+#ifndef SEAL_BGW_SHAMIR_H
+#define SEAL_BGW_SHAMIR_H
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include "../../../examples.h"
+using namespace std;
+
+/*  Z_p for a prime p < 2^62. Elements are kept in [0, p); products go through unsigned __int128.
+ *  Signed values are embedded as x mod p and read back from the centered range (-p/2, p/2].  */
+class Prime_Field
+{
+private:
+    uint64_t p;
+
+public:
+    explicit Prime_Field(uint64_t prime) : p(prime)
+    {
+        if (prime < 3 || prime >= (1ULL << 62))
+        {
+            throw invalid_argument("Prime_Field: the prime must be in [3, 2^62)");
+        }
+    }
+
+    uint64_t prime() const
+    {
+        return p;
+    }
+
+    uint64_t add(uint64_t a, uint64_t b) const
+    {
+        uint64_t s = a + b;
+        return (s >= p) ? s - p : s;
+    }
+
+    uint64_t sub(uint64_t a, uint64_t b) const
+    {
+        return (a >= b) ? a - b : a + p - b;
+    }
+
+    uint64_t neg(uint64_t a) const
+    {
+        return a ? p - a : 0;
+    }
+
+    uint64_t mul(uint64_t a, uint64_t b) const
+    {
+        return (uint64_t)((unsigned __int128)a * b % p);
+    }
+
+    uint64_t pow(uint64_t base, uint64_t exponent) const
+    {
+        uint64_t result = 1;
+        for (; exponent; exponent >>= 1)
+        {
+            if (exponent & 1)
+            {
+                result = mul(result, base);
+            }
+            base = mul(base, base);
+        }
+        return result;
+    }
+
+    /*  Fermat: a^(p-2) = a^-1  */
+    uint64_t inv(uint64_t a) const
+    {
+        if (a == 0)
+        {
+            throw invalid_argument("Prime_Field: 0 has no inverse");
+        }
+        return pow(a, p - 2);
+    }
+
+    uint64_t from_signed(long long int value) const
+    {
+        long long int r = value % (long long int)p;
+        return (uint64_t)(r < 0 ? r + (long long int)p : r);
+    }
+
+    long long int to_signed(uint64_t a) const
+    {
+        return (a > p / 2) ? (long long int)a - (long long int)p : (long long int)a;
+    }
+
+    uint64_t random(mt19937_64& gen) const
+    {
+        return uniform_int_distribution<uint64_t>(0, p - 1)(gen);
+    }
+};
+
+/*  Deterministic Miller-Rabin: these bases decide primality for every n < 2^64  */
+inline bool is_prime(uint64_t n)
+{
+    if (n < 2)
+    {
+        return false;
+    }
+    for (uint64_t small : {2ULL, 3ULL, 5ULL, 7ULL, 11ULL, 13ULL, 17ULL, 19ULL, 23ULL, 29ULL, 31ULL, 37ULL})
+    {
+        if (n % small == 0)
+        {
+            return n == small;
+        }
+    }
+    uint64_t d = n - 1;
+    int s = 0;
+    for (; (d & 1) == 0; d >>= 1)
+    {
+        s++;
+    }
+    auto mulmod = [n](uint64_t a, uint64_t b) { return (uint64_t)((unsigned __int128)a * b % n); };
+    for (uint64_t a : {2ULL, 3ULL, 5ULL, 7ULL, 11ULL, 13ULL, 17ULL, 19ULL, 23ULL, 29ULL, 31ULL, 37ULL})
+    {
+        uint64_t x = 1, base = a, e = d;
+        for (; e; e >>= 1)
+        {
+            if (e & 1)
+            {
+                x = mulmod(x, base);
+            }
+            base = mulmod(base, base);
+        }
+        if (x == 1 || x == n - 1)
+        {
+            continue;
+        }
+        bool composite = true;
+        for (int r = 1; r < s && composite; r++)
+        {
+            x = mulmod(x, x);
+            composite = (x != n - 1);
+        }
+        if (composite)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*  The smallest prime with exactly `bits` bits (as sized by BGW_client::get_prime_size)  */
+inline uint64_t find_prime(int bits)
+{
+    if (bits < 3 || bits > 62)
+    {
+        throw invalid_argument("find_prime: the field supports 3 to 62 bits");
+    }
+    for (uint64_t candidate = (1ULL << (bits - 1)) + 1; ; candidate += 2)
+    {
+        if (is_prime(candidate))
+        {
+            return candidate;
+        }
+    }
+}
+
+/*  The Lagrange basis of the points xs evaluated at x: for the polynomial of degree < |xs| through
+ *  (xs[i], y_i),  f(x) = sum_i lambda_i y_i  */
+inline vector<uint64_t> lagrange_at(const Prime_Field& field, const vector<uint64_t>& xs, uint64_t x)
+{
+    vector<uint64_t> lambda(xs.size());
+    for (size_t i = 0; i < xs.size(); i++)
+    {
+        uint64_t num = 1, den = 1;
+        for (size_t j = 0; j < xs.size(); j++)
+        {
+            if (j != i)
+            {
+                num = field.mul(num, field.sub(x, xs[j]));
+                den = field.mul(den, field.sub(xs[i], xs[j]));
+            }
+        }
+        lambda[i] = field.mul(num, field.inv(den));
+    }
+    return lambda;
+}
+
+/*  Recombination vector: the Lagrange coefficients at 0, f(0) = sum_i lambda_i y_i.
+ *  For xs = 1..5 this is BGW_client::lamda = (5, -10, 10, -5, 1).  */
+inline vector<uint64_t> lagrange_at_zero(const Prime_Field& field, const vector<uint64_t>& xs)
+{
+    return lagrange_at(field, xs, 0);
+}
+
+/*  Shamir (t, n): party i (0-based) holds f(i + 1) for a random f of degree t with f(0) = secret.
+ *  Any t+1 shares reconstruct, t shares reveal nothing. The batch functions share/reconstruct a vector,
+ *  shares[i][k] = party i's share of values[k].  */
+inline vector<vector<uint64_t>> shamir_share_batch(const Prime_Field& field, const vector<uint64_t>& values,
+                                                   int t, int n, mt19937_64& gen)
+{
+    vector<vector<uint64_t>> shares(n, vector<uint64_t>(values.size()));
+    vector<uint64_t> coefficients(t + 1);
+    for (size_t k = 0; k < values.size(); k++)
+    {
+        coefficients[0] = values[k];
+        for (int c = 1; c <= t; c++)
+        {
+            coefficients[c] = field.random(gen);
+        }
+        for (int i = 0; i < n; i++)
+        {
+            /*  Horner at x = i + 1  */
+            uint64_t x = i + 1, y = 0;
+            for (int c = t; c >= 0; c--)
+            {
+                y = field.add(field.mul(y, x), coefficients[c]);
+            }
+            shares[i][k] = y;
+        }
+    }
+    return shares;
+}
+
+/*  Reconstruct from the shares of the parties in `parties` (0-based), at least degree+1 of them  */
+inline vector<uint64_t> shamir_reconstruct_batch(const Prime_Field& field, const vector<vector<uint64_t>>& shares,
+                                                 const vector<int>& parties)
+{
+    vector<uint64_t> xs;
+    for (int party : parties)
+    {
+        xs.push_back(party + 1);
+    }
+    vector<uint64_t> lambda = lagrange_at_zero(field, xs);
+
+    size_t batch = shares[parties[0]].size();
+    vector<uint64_t> values(batch, 0);
+    for (size_t i = 0; i < parties.size(); i++)
+    {
+        const vector<uint64_t>& party_shares = shares[parties[i]];
+        for (size_t k = 0; k < batch; k++)
+        {
+            values[k] = field.add(values[k], field.mul(lambda[i], party_shares[k]));
+        }
+    }
+    return values;
+}
+
+#endif // SEAL_BGW_SHAMIR_H
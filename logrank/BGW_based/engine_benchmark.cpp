@@ -0,0 +1,281 @@
+//
+// Head-to-head benchmark of the logrank pipelines: plaintext pooling, CKKS (evaluate, evaluate_with_random) and BGW.
+//
+
+#include <chrono>
+#include <fstream>
+#include <queue>
+#include "BGW_multiplication.h"
+#include "../../../examples.h"
+#include "../CKKS_based/client.h"
+#include "../CKKS_based/creator_server.h"
+#include "../CKKS_based/evaluator_server.h"
+#include "../CKKS_based/logrank_simulation.h"
+#include "../CKKS_based/real_values_simulation.h"
+#include "../CKKS_based/serv_func.h"
+using namespace std;
+using namespace seal;
+
+/*  One engine on one cohort. Rounds are the sequential message exchanges until the analyst knows Z
+ *  (uploads included); bytes are everything sent on the way.  */
+struct Engine_Run
+{
+    string engine;
+    int num_of_clients = 0;
+    double client_ms = 0;           // mean compute of one client (encode + encrypt, or share)
+    size_t upload_bytes = 0;        // sent by one client
+    size_t total_bytes = 0;
+    size_t rounds = 0;
+    double end_to_end_ms = 0;       // every client in turn, then the servers, until Z is known
+    double Z = 0;
+    double true_Z = 0;
+    bool failed = false;
+};
+
+/*  The cohort: client i is site i % 5 of Mainz case (i / 5) % 5, so every engine and client count sees the
+ *  same real inputs. r is a seeded integer mask in [1, 16], usable by the BGW field as is.  */
+static vector<ClientsInput> engine_cohort(int num_of_clients, uint64_t seed)
+{
+    vector<ClientsInput> cohort(num_of_clients);
+    mt19937_64 gen(seed);
+    for (int i = 0; i < num_of_clients; i++)
+    {
+        Inputs5Clients mainz = take_inputs_from_data((i / 5) % 5);
+        ClientsInput sites[5] = {{mainz.O1, mainz.E1, mainz.V1, 0}, {mainz.O2, mainz.E2, mainz.V2, 0},
+                                 {mainz.O3, mainz.E3, mainz.V3, 0}, {mainz.O4, mainz.E4, mainz.V4, 0},
+                                 {mainz.O5, mainz.E5, mainz.V5, 0}};
+        cohort[i] = sites[i % 5];
+        cohort[i].r = (double)(1 + gen() % 16);
+    }
+    return cohort;
+}
+
+static double true_Z_of(const vector<ClientsInput>& cohort)
+{
+    double sigma_D = 0, sigma_U = 0;
+    for (const ClientsInput& input : cohort)
+    {
+        sigma_D += input.O - input.E;
+        sigma_U += input.V;
+    }
+    return sigma_D / sqrt(sigma_U);
+}
+
+static double elapsed_ms(chrono::high_resolution_clock::time_point time_start)
+{
+    return chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - time_start).count()
+           / 1000.0;
+}
+
+/*  The baseline without privacy: every client sends O-E and V in the clear  */
+static Engine_Run run_plaintext_engine(const vector<ClientsInput>& cohort)
+{
+    Engine_Run run;
+    run.engine = "plaintext";
+    run.num_of_clients = cohort.size();
+
+    chrono::high_resolution_clock::time_point time_start = chrono::high_resolution_clock::now();
+    double sigma_D = 0, sigma_U = 0;
+    for (const ClientsInput& input : cohort)
+    {
+        sigma_D += input.O - input.E;
+        sigma_U += input.V;
+    }
+    run.Z = sigma_D / sqrt(sigma_U);
+    run.end_to_end_ms = elapsed_ms(time_start);
+
+    run.upload_bytes = 2 * sizeof(double);
+    run.total_bytes = cohort.size() * run.upload_bytes;
+    run.rounds = 1;
+    return run;
+}
+
+/*  CKKS: the clients encrypt (O-E, V), and r as well for the randomized statistic. The evaluator aggregates
+ *  (and multiplies by R), the creator server decrypts D and U.  */
+static Engine_Run run_ckks_engine(const vector<ClientsInput>& cohort, bool randomized)
+{
+    Engine_Run run;
+    run.engine = randomized ? "ckks_evaluate_with_random" : "ckks_evaluate";
+    run.num_of_clients = cohort.size();
+
+    const int scale_cost_param = 30;
+    double scale = pow(2.0, scale_cost_param);
+    std::queue<Cipher_Msg> enc_msg_q;
+    std::queue<Decrypted_Result> decrypted_result_q;
+    std::shared_ptr<SEALContext> context = create_context(scale_cost_param);
+    std::shared_ptr<CKKSEncoder> encoder = create_encoder(context);
+    creator_server key_server(context, encoder, &decrypted_result_q);
+    evaluator_server eval_server(context, key_server.get_relin_keys(), &enc_msg_q, scale);
+    Encryptor encryptor(context, key_server.get_public_key());
+
+    /*  1. Clients  */
+    double clients_ms = 0;
+    for (const ClientsInput& input : cohort)
+    {
+        chrono::high_resolution_clock::time_point time_start = chrono::high_resolution_clock::now();
+        Cipher_Msg msg;
+        if (randomized)
+        {
+            msg = create_encrypted_msg(*encoder, encryptor, scale, input.O, input.E, input.V, input.r);
+        }
+        else
+        {
+            MemoryPoolHandle pool = stage_pool(STAGE_CLIENT_ENCRYPT);
+            Plaintext plain_O_minus_E(pool), plain_V(pool);
+            encoder->encode(input.O - input.E, scale, plain_O_minus_E, pool);
+            encoder->encode(input.V, scale, plain_V, pool);
+            msg = Cipher_Msg(pool);
+            encryptor.encrypt(plain_O_minus_E, msg.enc_O_minus_E, pool);
+            encryptor.encrypt(plain_V, msg.enc_V, pool);
+            logrank_metrics().encrypt.add(2);
+        }
+        clients_ms += elapsed_ms(time_start);
+
+        run.upload_bytes = msg.enc_O_minus_E.save_size() + msg.enc_V.save_size() +
+                           (randomized ? msg.enc_r.save_size() : 0);
+        run.total_bytes += run.upload_bytes;
+        enc_msg_q.push(std::move(msg));
+    }
+
+    /*  2. Evaluator and creator server  */
+    chrono::high_resolution_clock::time_point time_start = chrono::high_resolution_clock::now();
+    Encrypted_Result result = randomized ? eval_server.evaluate_with_random() : eval_server.evaluate();
+    run.total_bytes += result.D_encrypted.save_size() + result.U_encrypted.save_size();
+    key_server.decrypt_msg(result);
+    double servers_ms = elapsed_ms(time_start);
+
+    run.Z = decrypted_result_q.front().D / sqrt(decrypted_result_q.front().U);
+    run.client_ms = clients_ms / max((size_t)1, cohort.size());
+    run.end_to_end_ms = clients_ms + servers_ms;
+    run.rounds = 2;
+    return run;
+}
+
+/*  BGW with n computing parties: every client Shamir-shares (O-E, V, r) to them, the parties add locally,
+ *  multiply D = T0 R and U = T1 R^2 in two rounds, and t+1 of them open D and U to the analyst.
+ *  The field is sized for |T1 R^2| at fraction_bits; runs that need more than 62 bits are marked failed.  */
+static Engine_Run run_bgw_engine(const vector<ClientsInput>& cohort, int n, int t, int fraction_bits, uint64_t seed)
+{
+    Engine_Run run;
+    run.engine = "bgw";
+    run.num_of_clients = cohort.size();
+
+    double sigma_D = 0, sigma_U = 0, sigma_R = 0;
+    for (const ClientsInput& input : cohort)
+    {
+        sigma_D += std::abs(input.O - input.E);
+        sigma_U += input.V;
+        sigma_R += input.r;
+    }
+    int bits = (int)ceil(log2(max(sigma_D, sigma_U) * sigma_R * sigma_R)) + fraction_bits + 2;
+    if (bits > 62)
+    {
+        cout << " BGW, " << cohort.size() << " clients: T1 R^2 needs a " << bits << "-bit field" << endl;
+        run.failed = true;
+        return run;
+    }
+
+    Prime_Field field(find_prime(max(bits, 3)));
+    BGW_network network(field, n, t, seed);
+    mt19937_64 gen(seed + 1);
+    long long int scale = 1LL << fraction_bits;
+
+    /*  1. Clients  */
+    vector<vector<uint64_t>> T_shares(n, vector<uint64_t>(2, 0));
+    vector<vector<uint64_t>> R_shares(n, vector<uint64_t>(2, 0));
+    double clients_ms = 0;
+    for (const ClientsInput& input : cohort)
+    {
+        chrono::high_resolution_clock::time_point time_start = chrono::high_resolution_clock::now();
+        vector<uint64_t> values = {field.from_signed(llround((input.O - input.E) * scale)),
+                                   field.from_signed(llround(input.V * scale)),
+                                   field.from_signed(llround(input.r))};
+        vector<vector<uint64_t>> shares = shamir_share_batch(field, values, t, n, gen);
+        clients_ms += elapsed_ms(time_start);
+
+        for (int i = 0; i < n; i++)
+        {
+            T_shares[i][0] = field.add(T_shares[i][0], shares[i][0]);
+            T_shares[i][1] = field.add(T_shares[i][1], shares[i][1]);
+            R_shares[i][0] = field.add(R_shares[i][0], shares[i][2]);
+            R_shares[i][1] = field.add(R_shares[i][1], shares[i][2]);
+        }
+    }
+
+    /*  2. Parties: [T0 R, T1 R], then U = (T1 R) R, then open  */
+    chrono::high_resolution_clock::time_point time_start = chrono::high_resolution_clock::now();
+    vector<vector<uint64_t>> products = network.multiply(T_shares, R_shares);
+    vector<vector<uint64_t>> U_left(n), R_right(n), D_U(n);
+    for (int i = 0; i < n; i++)
+    {
+        U_left[i] = {products[i][1]};
+        R_right[i] = {R_shares[i][1]};
+    }
+    vector<vector<uint64_t>> U_shares = network.multiply(U_left, R_right);
+    for (int i = 0; i < n; i++)
+    {
+        D_U[i] = {products[i][0], U_shares[i][0]};
+    }
+    vector<int> openers;
+    for (int i = 0; i <= t; i++)
+    {
+        openers.push_back(i);
+    }
+    vector<uint64_t> opened = shamir_reconstruct_batch(field, D_U, openers);
+    double servers_ms = elapsed_ms(time_start);
+
+    double D = (double)field.to_signed(opened[0]) / scale;
+    double U = (double)field.to_signed(opened[1]) / scale;
+    run.Z = D / sqrt(U);
+    run.client_ms = clients_ms / max((size_t)1, cohort.size());
+    run.end_to_end_ms = clients_ms + servers_ms;
+    run.upload_bytes = n * 3 * sizeof(uint64_t);
+    run.total_bytes = cohort.size() * run.upload_bytes + (network.get_elements_sent() + (t + 1) * 2) * sizeof(uint64_t);
+    run.rounds = 1 + network.get_rounds() + 1;
+    return run;
+}
+
+/*  Every engine on the same cohort for every client count. One CSV row per (engine, client count).  */
+vector<Engine_Run> Logrank_engine_benchmark(const vector<int>& client_counts, const string& csv_path)
+{
+    cout << " -------------------------------" << endl;
+    cout << " ---START ENGINE BENCHMARK------" << endl;
+    cout << " -------------------------------" << endl;
+
+    const int n = 5, t = 2, fraction_bits = 12;
+    vector<Engine_Run> runs;
+    for (int num_of_clients : client_counts)
+    {
+        vector<ClientsInput> cohort = engine_cohort(num_of_clients, 1);
+        double true_Z = true_Z_of(cohort);
+
+        vector<Engine_Run> engines = {run_plaintext_engine(cohort), run_ckks_engine(cohort, false),
+                                      run_ckks_engine(cohort, true), run_bgw_engine(cohort, n, t, fraction_bits, 2)};
+        for (Engine_Run& run : engines)
+        {
+            run.true_Z = true_Z;
+            runs.push_back(run);
+        }
+    }
+
+    ofstream csv(csv_path);
+    const string header = "engine,clients,client_ms,upload_bytes,total_bytes,rounds,end_to_end_ms,Z,true_Z,"
+                          "rel_error,failed";
+    cout << header << endl;
+    csv << header << endl;
+    for (const Engine_Run& run : runs)
+    {
+        stringstream row;
+        row << run.engine << "," << run.num_of_clients << "," << run.client_ms << "," << run.upload_bytes << ","
+            << run.total_bytes << "," << run.rounds << "," << run.end_to_end_ms << "," << run.Z << ","
+            << run.true_Z << "," << std::abs((run.Z - run.true_Z) / run.true_Z) << "," << run.failed;
+        cout << row.str() << endl;
+        csv << row.str() << endl;
+    }
+    return runs;
+}
+
+void example_engine_benchmark_test()
+{
+    Logrank_engine_benchmark({5, 50, 500}, "logrank_engines.csv");
+}
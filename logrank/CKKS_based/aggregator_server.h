@@ -0,0 +1,93 @@
+//
+// Intermediate (regional) aggregator for the hierarchical evaluation mode.
+//
+
+#ifndef SEAL_AGGREGATOR_SERVER_H
+#define SEAL_AGGREGATOR_SERVER_H
+
+#include <queue>
+#include "../../../examples.h"
+#include "serv_func.h"
+
+/*  An aggregator sits between a group of children (clients or lower aggregators) and its parent
+ *  (a higher aggregator or the evaluator_server). It runs the calculate_sigma sums over its children and
+ *  forwards a single partial-sum Cipher_Msg, so the parent's ingress is its fan-out instead of the number
+ *  of clients. Sums are associative, so the root's evaluate / evaluate_with_random is unchanged.  */
+class aggregator_server
+{
+private:
+    std::shared_ptr<SEALContext> context;
+    Evaluator* evaluator;
+
+    /*  child_q - the channel from the children, parent_q - the channel to the parent.
+     *  Both must be secure in the same sense as enc_msg_q.  */
+    std::queue<Cipher_Msg>* child_q;
+    std::queue<Cipher_Msg>* parent_q;
+
+    size_t ingress_count = 0;
+
+    /*  calculate_sigma without its log: the aggregators of a level run concurrently, and their lines would
+     *  interleave on cout  */
+    void sum_field(vector<Ciphertext>& field, Ciphertext& partial_sum)
+    {
+        /*  Fields the clients left empty (e.g. enc_r in the non-randomized protocol) stay empty  */
+        if (field.empty() || field.front().size() == 0)
+        {
+            return;
+        }
+        partial_sum = Ciphertext(stage_pool(STAGE_AGGREGATE));
+        evaluator->add_many(field, partial_sum);
+        logrank_metrics().add.add(field.size() - 1);
+    }
+
+public:
+    aggregator_server(std::shared_ptr<SEALContext> context_, std::queue<Cipher_Msg>* child_q_,
+                      std::queue<Cipher_Msg>* parent_q_)
+    {
+        context = context_;
+        child_q = child_q_;
+        parent_q = parent_q_;
+        evaluator = new Evaluator(context);
+    }
+
+    ~aggregator_server()
+    {
+        delete evaluator;
+    }
+
+    aggregator_server(const aggregator_server&) = delete;
+    aggregator_server& operator=(const aggregator_server&) = delete;
+
+    void aggregate()
+    {
+        /*  Read all the cipher msgs from the children.
+         *  We assume that when this method is called all the children already put their msgs in the queue  */
+        vector<Cipher_Msg> msg_vec;
+        while(!child_q->empty())
+        {
+            msg_vec.push_back(std::move(child_q->front()));
+            child_q->pop();
+        }
+        if (msg_vec.empty())
+        {
+            return;
+        }
+        ingress_count += msg_vec.size();
+
+        Basic_Vectors basicVectors = create_basic_vectors(std::move(msg_vec));
+
+        Cipher_Msg partial_sum;
+        sum_field(basicVectors.r_encrypted_vector, partial_sum.enc_r);
+        sum_field(basicVectors.T0_encrypted_vector, partial_sum.enc_O_minus_E);
+        sum_field(basicVectors.T1_encrypted_vector, partial_sum.enc_V);
+
+        parent_q->push(std::move(partial_sum));
+    }
+
+    size_t get_ingress_count() const
+    {
+        return ingress_count;
+    }
+};
+
+#endif // SEAL_AGGREGATOR_SERVER_H
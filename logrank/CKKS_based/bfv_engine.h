@@ -0,0 +1,189 @@
+//
+// Integer-exact BFV engine for the (O-E, V) sums.
+//
+
+#ifndef SEAL_BFV_ENGINE_H
+#define SEAL_BFV_ENGINE_H
+
+#include <cmath>
+#include <cstdint>
+#include <queue>
+#include "../../../examples.h"
+#include "serv_func.h"
+
+/*  Inputs are moved to fixed point with fraction_bits binary digits: x -> round(x * 2^fraction_bits).
+ *  O is an integer count and is represented exactly; E and V carry a rounding error of at most
+ *  2^-(fraction_bits+1) per client, and from there on every addition is exact.  */
+inline int64_t to_fixed_point(double value, int fraction_bits)
+{
+    return (int64_t)llround(std::ldexp(value, fraction_bits));
+}
+
+inline double from_fixed_point(int64_t value, int fraction_bits)
+{
+    return std::ldexp((double)value, -fraction_bits);
+}
+
+/*  The plaintext modulus must hold the sum of k fixed-point inputs with |input| < 2^Lmax, plus a sign bit,
+ *  so that the centered decoding never wraps around. This is the additive counterpart of
+ *  BGW_client::get_prime_size (31 + Lmax + 3 log2(k)), which also leaves room for the products of the
+ *  randomized protocol. Batching limits the plaintext modulus to 60 bits.  */
+inline int bfv_plain_modulus_bits(int fraction_bits, int Lmax, int k)
+{
+    int bits = fraction_bits + Lmax + (int)ceil(log2(max(k, 1))) + 1;
+    if (bits > 60)
+    {
+        throw invalid_argument("bfv_plain_modulus_bits: " + to_string(bits) + " bits exceed the batching limit of 60");
+    }
+    return max(bits, 17);
+}
+
+/*  The same msg as client::get_encryped_msg, encoded in slot 0 of a BFV batch instead of a CKKS scale.
+ *  The evaluator sums Cipher_Msgs without looking at the scheme, so evaluator_server is shared.  */
+class bfv_client
+{
+private:
+    std::shared_ptr<BatchEncoder> encoder;
+    Encryptor* encryptor;
+    int fraction_bits;
+    double O_minus_E;
+    double V;
+    int client_id;
+
+    std::queue<Cipher_Msg>* enc_msg_q;
+
+public:
+    bfv_client(std::shared_ptr<SEALContext> context, std::shared_ptr<BatchEncoder> encoder_, const PublicKey& public_key,
+               std::queue<Cipher_Msg>* enc_msg_q_, int fraction_bits_, double O, double E, double V_, int client_id_ = -1)
+    {
+        encoder = encoder_;
+        encryptor = new Encryptor(context, public_key);
+        enc_msg_q = enc_msg_q_;
+        fraction_bits = fraction_bits_;
+        O_minus_E = O - E;
+        V = V_;
+        client_id = client_id_;
+    }
+
+    ~bfv_client()
+    {
+        delete encryptor;
+    }
+
+    bfv_client(const bfv_client&) = delete;
+    bfv_client& operator=(const bfv_client&) = delete;
+
+    void get_encryped_msg()
+    {
+        vector<int64_t> O_minus_E_slots(encoder->slot_count(), 0);
+        vector<int64_t> V_slots(encoder->slot_count(), 0);
+        O_minus_E_slots[0] = to_fixed_point(O_minus_E, fraction_bits);
+        V_slots[0] = to_fixed_point(V, fraction_bits);
+
+        MemoryPoolHandle pool = stage_pool(STAGE_CLIENT_ENCRYPT);
+        Plaintext plain_O_minus_E(pool), plain_V(pool);
+        encoder->encode(O_minus_E_slots, plain_O_minus_E);
+        encoder->encode(V_slots, plain_V);
+
+        Cipher_Msg cipher(pool);
+        cipher.client_id = client_id;
+        encryptor->encrypt(plain_O_minus_E, cipher.enc_O_minus_E, pool);
+        encryptor->encrypt(plain_V, cipher.enc_V, pool);
+        logrank_metrics().encrypt.add(2);
+
+        enc_msg_q->push(std::move(cipher));
+    }
+};
+
+/*  The BFV key server. Besides the Decrypted_Result (in doubles, as the CKKS creator_server sends it),
+ *  it keeps the exact fixed-point sums of the last decryption.  */
+class bfv_creator_server
+{
+private:
+    std::shared_ptr<SEALContext> context;
+    std::shared_ptr<BatchEncoder> encoder;
+    Decryptor* decryptor;
+    int fraction_bits;
+
+    std::queue<Decrypted_Result>* decrypted_result_q;
+
+    SecretKey secret_key;
+    PublicKey public_key;
+    RelinKeys relin_keys;
+
+    int64_t fixed_D = 0;
+    int64_t fixed_U = 0;
+
+public:
+    bfv_creator_server(std::shared_ptr<SEALContext> context_, std::shared_ptr<BatchEncoder> encoder_,
+                       std::queue<Decrypted_Result>* decrypted_result_q_, int fraction_bits_)
+    {
+        context = context_;
+        encoder = encoder_;
+        decrypted_result_q = decrypted_result_q_;
+        fraction_bits = fraction_bits_;
+
+        KeyGenerator keygen(context);
+        public_key = keygen.public_key();
+        secret_key = keygen.secret_key();
+        relin_keys = keygen.relin_keys_local();
+
+        decryptor = new Decryptor(context, secret_key);
+    }
+
+    ~bfv_creator_server()
+    {
+        delete decryptor;
+    }
+
+    const PublicKey& get_public_key() const
+    {
+        return public_key;
+    }
+
+    const RelinKeys& get_relin_keys() const
+    {
+        return relin_keys;
+    }
+
+    void decrypt_msg(const Encrypted_Result& encryptedResult)
+    {
+        MemoryPoolHandle pool = stage_pool(STAGE_DECRYPT);
+        Plaintext D_plain(pool), U_plain(pool);
+        decryptor->decrypt(encryptedResult.D_encrypted, D_plain);
+        decryptor->decrypt(encryptedResult.U_encrypted, U_plain);
+        logrank_metrics().decrypt.add(2);
+        print_line(__LINE__);
+        cout << "Noise budget left in D_encrypted: " << decryptor->invariant_noise_budget(encryptedResult.D_encrypted)
+             << " bits" << endl;
+
+        /*  The int64 decoding is centered: values above t/2 come back negative  */
+        vector<int64_t> D_result, U_result;
+        encoder->decode(D_plain, D_result, pool);
+        encoder->decode(U_plain, U_result, pool);
+        fixed_D = D_result[0];
+        fixed_U = U_result[0];
+
+        Decrypted_Result result;
+        result.D = from_fixed_point(fixed_D, fraction_bits);
+        result.U = from_fixed_point(fixed_U, fraction_bits);
+
+        while(!decrypted_result_q->empty())
+        {
+            decrypted_result_q->pop();
+        }
+        decrypted_result_q->push(std::move(result));
+    }
+
+    int64_t get_fixed_point_D() const
+    {
+        return fixed_D;
+    }
+
+    int64_t get_fixed_point_U() const
+    {
+        return fixed_U;
+    }
+};
+
+#endif // SEAL_BFV_ENGINE_H
@@ -0,0 +1,172 @@
+//
+// CKKS against the integer-exact BFV engine on the same inputs.
+//
+
+#include <exception>
+#include <queue>
+#include "../../../examples.h"
+#include "bfv_engine.h"
+#include "client.h"
+#include "creator_server.h"
+#include "evaluator_server.h"
+#include "logrank_simulation.h"
+#include "serv_func.h"
+using namespace std;
+using namespace seal;
+
+struct Engine_Report
+{
+    string name;
+    size_t msg_bytes;
+    double encrypt_per_sec;
+    double add_per_sec;
+    double D;
+    double U;
+};
+
+static void print_engine_report(const Engine_Report& report, double true_D, double true_U)
+{
+    cout << report.name << ":" << endl;
+    cout << "    + ciphertext msg size: " << report.msg_bytes << " bytes" << endl;
+    cout << "    + encryptions/s: " << report.encrypt_per_sec << endl;
+    cout << "    + aggregated msgs/s: " << report.add_per_sec << endl;
+    cout << "    + |D - true D| = " << std::abs(report.D - true_D) << ", |U - true U| = "
+         << std::abs(report.U - true_U) << endl;
+    cout << "    + Z = " << report.D / sqrt(report.U) << " (true " << true_D / sqrt(true_U) << ")" << endl;
+}
+
+void Logrank_bfv_sim(int num_of_clients, int fraction_bits)
+{
+    cout << " --------------------------------" << endl;
+    cout << " ---START BFV ENGINE SIMULATION---" << endl;
+    cout << " --------------------------------" << endl;
+
+    vector<ClientsInput> inputs(num_of_clients);
+    sample_inputs_clients(inputs.data(), num_of_clients);
+
+    /*  The exact sums, both in doubles and in the fixed point BFV sees  */
+    double true_D = 0, true_U = 0;
+    int64_t fixed_true_D = 0, fixed_true_U = 0;
+    double max_magnitude = 1;
+    for (int i=0; i<num_of_clients; i++)
+    {
+        true_D += inputs[i].O - inputs[i].E;
+        true_U += inputs[i].V;
+        fixed_true_D += to_fixed_point(inputs[i].O - inputs[i].E, fraction_bits);
+        fixed_true_U += to_fixed_point(inputs[i].V, fraction_bits);
+        max_magnitude = max(max_magnitude, max(std::abs(inputs[i].O - inputs[i].E), inputs[i].V));
+    }
+
+    Engine_Report reports[2];
+
+    /*  1. CKKS (the original protocol)  */
+    {
+        std::queue<Cipher_Msg> enc_msg_q;
+        std::queue<Decrypted_Result> decrypted_result_q;
+        const int scale_cost_param = 30;
+        double scale = pow(2.0, scale_cost_param);
+
+        std::shared_ptr<SEALContext> context = create_context(scale_cost_param, CKKS_ENGINE, 0);
+        std::shared_ptr<CKKSEncoder> encoder = create_encoder(context);
+        creator_server key_server(context, encoder, &decrypted_result_q);
+        evaluator_server eval_server(context, key_server.get_relin_keys(), &enc_msg_q, scale);
+
+        vector<client*> clients(num_of_clients);
+        for (int i=0; i<num_of_clients; i++)
+        {
+            clients[i] = new client(context, encoder, key_server.get_public_key(), &enc_msg_q, &decrypted_result_q,
+                                    scale, inputs[i].O, inputs[i].E, inputs[i].V, inputs[i].r, i);
+        }
+
+        chrono::high_resolution_clock::time_point time_start = chrono::high_resolution_clock::now();
+        for (int i=0; i<num_of_clients; i++)
+        {
+            clients[i]->get_encryped_msg();
+        }
+        chrono::microseconds encrypt_time =
+            chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - time_start);
+        reports[0].msg_bytes = enc_msg_q.front().enc_O_minus_E.save_size() + enc_msg_q.front().enc_V.save_size();
+
+        time_start = chrono::high_resolution_clock::now();
+        Encrypted_Result result = eval_server.evaluate();
+        chrono::microseconds add_time =
+            chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - time_start);
+
+        key_server.decrypt_msg(result);
+        reports[0].name = "CKKS, scale 2^" + to_string(scale_cost_param);
+        reports[0].encrypt_per_sec = num_of_clients * 1000000.0 / max(1.0, (double)encrypt_time.count());
+        reports[0].add_per_sec = num_of_clients * 1000000.0 / max(1.0, (double)add_time.count());
+        reports[0].D = decrypted_result_q.front().D;
+        reports[0].U = decrypted_result_q.front().U;
+
+        for (int i=0; i<num_of_clients; i++)
+        {
+            delete clients[i];
+        }
+    }
+
+    /*  2. BFV on fixed-point inputs  */
+    {
+        std::queue<Cipher_Msg> enc_msg_q;
+        std::queue<Decrypted_Result> decrypted_result_q;
+
+        int Lmax = (int)floor(log2(max_magnitude)) + 1;
+        int plain_modulus_bits = bfv_plain_modulus_bits(fraction_bits, Lmax, num_of_clients);
+        std::shared_ptr<SEALContext> context = create_context(0, BFV_ENGINE, plain_modulus_bits);
+        auto encoder = std::make_shared<BatchEncoder>(context);
+        bfv_creator_server key_server(context, encoder, &decrypted_result_q, fraction_bits);
+        evaluator_server eval_server(context, key_server.get_relin_keys(), &enc_msg_q, 1.0);
+
+        vector<bfv_client*> clients(num_of_clients);
+        for (int i=0; i<num_of_clients; i++)
+        {
+            clients[i] = new bfv_client(context, encoder, key_server.get_public_key(), &enc_msg_q, fraction_bits,
+                                        inputs[i].O, inputs[i].E, inputs[i].V, i);
+        }
+
+        chrono::high_resolution_clock::time_point time_start = chrono::high_resolution_clock::now();
+        for (int i=0; i<num_of_clients; i++)
+        {
+            clients[i]->get_encryped_msg();
+        }
+        chrono::microseconds encrypt_time =
+            chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - time_start);
+        reports[1].msg_bytes = enc_msg_q.front().enc_O_minus_E.save_size() + enc_msg_q.front().enc_V.save_size();
+
+        time_start = chrono::high_resolution_clock::now();
+        Encrypted_Result result = eval_server.evaluate();
+        chrono::microseconds add_time =
+            chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - time_start);
+
+        key_server.decrypt_msg(result);
+        reports[1].name = "BFV, " + to_string(fraction_bits) + " fraction bits, " + to_string(plain_modulus_bits) +
+                          "-bit plain modulus";
+        reports[1].encrypt_per_sec = num_of_clients * 1000000.0 / max(1.0, (double)encrypt_time.count());
+        reports[1].add_per_sec = num_of_clients * 1000000.0 / max(1.0, (double)add_time.count());
+        reports[1].D = decrypted_result_q.front().D;
+        reports[1].U = decrypted_result_q.front().U;
+
+        /*  The fixed-point sums must match bit for bit  */
+        if (key_server.get_fixed_point_D() != fixed_true_D || key_server.get_fixed_point_U() != fixed_true_U)
+        {
+            cout << "---- ERROR!! ----- BFV sums are not exact" << endl;
+            throw;
+        }
+        cout << "BFV fixed-point sums are exact" << endl;
+
+        for (int i=0; i<num_of_clients; i++)
+        {
+            delete clients[i];
+        }
+    }
+
+    for (const Engine_Report& report : reports)
+    {
+        print_engine_report(report, true_D, true_U);
+    }
+}
+
+void example_bfv_logrank_test()
+{
+    Logrank_bfv_sim(100, 20);
+}
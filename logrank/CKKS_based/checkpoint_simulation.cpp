@@ -0,0 +1,146 @@
+//
+// Crash and resume of the evaluation server from its checkpoint log.
+//
+
+#include <cstdio>
+#include <exception>
+#include <queue>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../../../examples.h"
+#include "client.h"
+#include "creator_server.h"
+#include "evaluator_server.h"
+#include "logrank_simulation.h"
+#include "serv_func.h"
+using namespace std;
+using namespace seal;
+
+static off_t file_size(const string& path)
+{
+    struct stat st;
+    return (::stat(path.c_str(), &st) == 0) ? st.st_size : 0;
+}
+
+void Logrank_checkpoint_sim(int num_of_clients, int crash_after, int checkpoint_interval, int records_per_fsync)
+{
+    cout << " ---------------------------------" << endl;
+    cout << " ---START CHECKPOINT SIMULATION---" << endl;
+    cout << " ---------------------------------" << endl;
+
+    const string checkpoint_path = "evaluator_checkpoint.log";
+    std::remove(checkpoint_path.c_str());
+
+    std::queue<Cipher_Msg> enc_msg_q;
+    std::queue<Decrypted_Result> decrypted_result_q;
+
+    const int scale_cost_param = 30;
+    double scale = pow(2.0, scale_cost_param);
+
+    std::shared_ptr<SEALContext> context = create_context(scale_cost_param);
+    std::shared_ptr<CKKSEncoder> encoder = create_encoder(context);
+
+    vector<ClientsInput> inputs(num_of_clients);
+    sample_inputs_clients(inputs.data(), num_of_clients);
+
+    double sigma_O = 0, sigma_E = 0, sigma_V = 0;
+    for (int i=0; i<num_of_clients; i++)
+    {
+        sigma_O += inputs[i].O;
+        sigma_E += inputs[i].E;
+        sigma_V += inputs[i].V;
+    }
+    double trueResult = ((sigma_O - sigma_E) / sqrt(sigma_V));
+    cout << " True value: " << trueResult << endl;
+
+    creator_server key_server(context, encoder, &decrypted_result_q);
+
+    vector<client*> clients(num_of_clients);
+    for (int i=0; i<num_of_clients; i++)
+    {
+        clients[i] = new client(context, encoder, key_server.get_public_key(), &enc_msg_q, &decrypted_result_q, scale,
+                                inputs[i].O, inputs[i].E, inputs[i].V, inputs[i].r, i);
+    }
+
+    /*  1. The evaluator merges crash_after msgs, then dies in the middle of writing one more record  */
+    chrono::high_resolution_clock::time_point time_start = chrono::high_resolution_clock::now();
+    evaluator_server* eval_server = new evaluator_server(context, key_server.get_relin_keys(), &enc_msg_q, scale);
+    eval_server->enable_checkpoints(checkpoint_path, checkpoint_interval, records_per_fsync);
+    for (int i=0; i<crash_after; i++)
+    {
+        clients[i]->get_encryped_msg();
+        eval_server->merge_arrivals();
+    }
+    chrono::microseconds run_time =
+        chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - time_start);
+
+    off_t complete_size = file_size(checkpoint_path);
+    eval_server->checkpoint();
+    off_t torn_size = file_size(checkpoint_path);
+    delete eval_server;
+    if (torn_size <= complete_size)
+    {
+        cout << "---- ERROR!! ----- the last record started a new log file, nothing to tear" << endl;
+        throw;
+    }
+    /*  Cut the last record in half, as a crash during its write() would  */
+    if (::truncate(checkpoint_path.c_str(), complete_size + (torn_size - complete_size) / 2) != 0)
+    {
+        throw runtime_error("cannot truncate " + checkpoint_path);
+    }
+
+    /*  2. A new evaluator resumes from the log. Only the clients missing from the checkpoint resend;
+     *  a resend from a client that is already in it would be dropped.  */
+    time_start = chrono::high_resolution_clock::now();
+    eval_server = new evaluator_server(context, key_server.get_relin_keys(), &enc_msg_q, scale);
+    eval_server->restore_from_checkpoint(checkpoint_path);
+    chrono::microseconds restore_time =
+        chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - time_start);
+
+    /*  The torn record held all crash_after msgs; the restore must fall back to the record before it  */
+    set<int> processed = eval_server->get_contributors();
+    if (processed.size() != (size_t)(crash_after / checkpoint_interval * checkpoint_interval))
+    {
+        cout << "---- ERROR!! ----- restored " << processed.size() << " clients, expected "
+             << crash_after / checkpoint_interval * checkpoint_interval << endl;
+        throw;
+    }
+    int resent = 0;
+    for (int i=0; i<num_of_clients; i++)
+    {
+        if (processed.count(i) == 0)
+        {
+            clients[i]->get_encryped_msg();
+            resent++;
+        }
+    }
+    eval_server->merge_arrivals();
+    Provisional_Result final_result = eval_server->get_provisional_result(num_of_clients);
+    chrono::microseconds recovery_time =
+        chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - time_start);
+
+    key_server.decrypt_msg(final_result.result);
+    verify_result(clients[0], trueResult);
+
+    cout << "Checkpoint every " << checkpoint_interval << " msgs, fsync every " << records_per_fsync
+         << " records, log of " << complete_size << " bytes at the crash:" << endl;
+    cout << "    + merging " << crash_after << " msgs before the crash: " << run_time.count() / 1000 << " ms" << endl;
+    cout << "    + restoring the checkpoint: " << restore_time.count() / 1000 << " ms" << endl;
+    cout << "    + clients resent: " << resent << " (lost work: " << crash_after + resent - num_of_clients
+         << " msgs)" << endl;
+    cout << "    + total recovery time: " << recovery_time.count() / 1000 << " ms" << endl;
+
+    delete eval_server;
+    for (int i=0; i<num_of_clients; i++)
+    {
+        delete clients[i];
+    }
+    std::remove(checkpoint_path.c_str());
+    std::remove((checkpoint_path + ".tmp").c_str());
+}
+
+void example_checkpoint_logrank_test()
+{
+    Logrank_checkpoint_sim(50, 37, 10, 1);
+    Logrank_checkpoint_sim(50, 37, 1, 5);
+}
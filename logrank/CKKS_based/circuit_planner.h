@@ -0,0 +1,467 @@
+//
+// A small expression-DAG compiler for CKKS evaluation circuits.
+//
+
+#ifndef SEAL_CIRCUIT_PLANNER_H
+#define SEAL_CIRCUIT_PLANNER_H
+
+#include <cmath>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../../../examples.h"
+#include "metrics.h"
+#include "stage_memory.h"
+
+using namespace std;
+using namespace seal;
+
+/*  A statistic is described as a DAG over the aggregated inputs, e.g. for the randomized protocol
+ *      D = T0 * R,   U = T1 * R^2
+ *  compile() turns the DAG into a straight-line sequence of SEAL operations:
+ *  - every multiplication is rescaled right away, so each node sits at a known depth (level);
+ *  - operands at different depths are brought together by mod switching the shallower one (no forced scales -
+ *    SEAL multiplies ciphertexts of different scales, and the exact scale of every node is tracked from the
+ *    primes of the modulus chain);
+ *  - relinearization is lazy: a ciphertext is relinearized only when the next product would exceed size 3
+ *    (the largest size the relin keys can bring back), or at the outputs if relinearize_outputs is set;
+ *  - a product by a constant encodes the constant at the scale of the prime the rescale drops, so it costs a
+ *    level but keeps the operand's scale;
+ *  - an addition of operands at different scales multiplies the shallower one by 1.0, encoded at the scale
+ *    that lands it exactly on the deeper one's scale and depth.
+ *  New statistics only need a new DAG, not hand-written level juggling.  */
+
+enum Circuit_Node_Type
+{
+    INPUT_NODE = 0,
+    ADD_NODE = 1,
+    MULTIPLY_NODE = 2,
+    SQUARE_NODE = 3,
+    MULTIPLY_CONST_NODE = 4,
+    ADD_CONST_NODE = 5
+};
+
+struct Circuit_Node
+{
+    Circuit_Node_Type type;
+    int lhs;
+    int rhs;
+    string name;
+    double value;
+};
+
+enum Circuit_Step_Type
+{
+    STEP_ADD = 0,
+    STEP_MULTIPLY = 1,
+    STEP_SQUARE = 2,
+    STEP_RELINEARIZE = 3,
+    STEP_RESCALE = 4,
+    STEP_MOD_SWITCH = 5,
+    STEP_MULTIPLY_PLAIN = 6,
+    STEP_ADD_PLAIN = 7
+};
+
+/*  One SEAL operation. Registers are ciphertext slots of the executor; dst may equal lhs (in place). */
+struct Circuit_Step
+{
+    Circuit_Step_Type type;
+    int dst;
+    int lhs;
+    int rhs;
+    size_t depth;   // for STEP_MOD_SWITCH: the target depth
+    double value;   // for STEP_MULTIPLY_PLAIN / STEP_ADD_PLAIN: the constant
+    double plain_scale;   // for STEP_MULTIPLY_PLAIN: the scale the constant is encoded at
+};
+
+struct Circuit_Plan
+{
+    vector<Circuit_Step> steps;
+    map<string, int> input_registers;
+    map<string, int> output_registers;
+    size_t num_of_registers = 0;
+    size_t depth = 0;
+
+    /*  Per-register bookkeeping computed at compile time  */
+    vector<size_t> register_depth;
+    vector<size_t> register_size;
+    vector<double> register_scale;
+
+    size_t count(Circuit_Step_Type type) const
+    {
+        size_t n = 0;
+        for (const Circuit_Step& step : steps)
+        {
+            n += (step.type == type);
+        }
+        return n;
+    }
+
+    /*  The evaluator needs relinearization keys only for plans that relinearize; no plan needs Galois keys  */
+    bool needs_relin_keys() const
+    {
+        return count(STEP_RELINEARIZE) > 0;
+    }
+};
+
+class Circuit
+{
+private:
+    vector<Circuit_Node> nodes;
+    vector<pair<string, int>> outputs;
+
+    int push(Circuit_Node_Type type, int lhs, int rhs, const string& name, double value = 0)
+    {
+        if (lhs >= (int)nodes.size() || rhs >= (int)nodes.size())
+        {
+            throw invalid_argument("Circuit: operand is not a node of this circuit");
+        }
+        nodes.push_back(Circuit_Node{type, lhs, rhs, name, value});
+        return (int)nodes.size() - 1;
+    }
+
+public:
+    int input(const string& name)
+    {
+        return push(INPUT_NODE, -1, -1, name);
+    }
+
+    int add(int a, int b)
+    {
+        return push(ADD_NODE, a, b, "");
+    }
+
+    int multiply(int a, int b)
+    {
+        return (a == b) ? square(a) : push(MULTIPLY_NODE, a, b, "");
+    }
+
+    int square(int a)
+    {
+        return push(SQUARE_NODE, a, a, "");
+    }
+
+    int multiply_const(int a, double value)
+    {
+        return push(MULTIPLY_CONST_NODE, a, a, "", value);
+    }
+
+    int add_const(int a, double value)
+    {
+        return push(ADD_CONST_NODE, a, a, "", value);
+    }
+
+    void output(const string& name, int node)
+    {
+        outputs.push_back(make_pair(name, node));
+    }
+
+    /*  scale - the scale of the encoded inputs.
+     *  The context provides the primes, so the exact scale after every rescale is known in advance.  */
+    Circuit_Plan compile(std::shared_ptr<SEALContext> context, double scale, bool relinearize_outputs = false) const
+    {
+        /*  The prime dropped by the k-th rescale, counted from the first (top) data level  */
+        vector<double> dropped_prime;
+        for (auto data = context->first_context_data(); data; data = data->next_context_data())
+        {
+            dropped_prime.push_back((double)data->parms().coeff_modulus().back().value());
+        }
+        size_t max_depth = context->first_context_data()->chain_index();
+
+        Circuit_Plan plan;
+        vector<int> node_register(nodes.size(), -1);
+
+        auto new_register = [&](size_t depth, size_t size, double reg_scale) {
+            plan.register_depth.push_back(depth);
+            plan.register_size.push_back(size);
+            plan.register_scale.push_back(reg_scale);
+            return (int)plan.num_of_registers++;
+        };
+
+        /*  Bring a register down to the given depth, on a copy if the original is still needed at its own depth  */
+        map<pair<int, size_t>, int> switched;
+        auto at_depth = [&](int reg, size_t depth) {
+            if (plan.register_depth[reg] == depth)
+            {
+                return reg;
+            }
+            auto found = switched.find(make_pair(reg, depth));
+            if (found != switched.end())
+            {
+                return found->second;
+            }
+            int copy = new_register(depth, plan.register_size[reg], plan.register_scale[reg]);
+            plan.steps.push_back(Circuit_Step{STEP_MOD_SWITCH, copy, reg, -1, depth, 0, 0});
+            switched[make_pair(reg, depth)] = copy;
+            return copy;
+        };
+
+        auto relinearize = [&](int reg) {
+            if (plan.register_size[reg] > 2)
+            {
+                plan.steps.push_back(Circuit_Step{STEP_RELINEARIZE, reg, reg, -1, plan.register_depth[reg], 0, 0});
+                plan.register_size[reg] = 2;
+            }
+        };
+
+        /*  reg * value, rescaled: value is encoded at plain_scale and the result lands one level deeper  */
+        auto multiply_plain = [&](int reg, double value, double plain_scale) {
+            size_t depth = plan.register_depth[reg];
+            if (depth + 1 > max_depth)
+            {
+                throw invalid_argument("Circuit: multiplicative depth exceeds the modulus chain");
+            }
+            int dst = new_register(depth, plan.register_size[reg], plan.register_scale[reg] * plain_scale);
+            plan.steps.push_back(Circuit_Step{STEP_MULTIPLY_PLAIN, dst, reg, -1, depth, value, plain_scale});
+            plan.steps.push_back(Circuit_Step{STEP_RESCALE, dst, dst, -1, depth + 1, 0, 0});
+            plan.register_depth[dst] = depth + 1;
+            plan.register_scale[dst] = plan.register_scale[dst] / dropped_prime[depth];
+            return dst;
+        };
+
+        /*  Bring reg to (depth, scale) exactly. Needs reg to be shallower than depth  */
+        auto match_scale = [&](int reg, size_t depth, double target_scale) {
+            if (plan.register_depth[reg] >= depth)
+            {
+                throw invalid_argument("Circuit: addition of operands at different scales");
+            }
+            reg = at_depth(reg, depth - 1);
+            int dst = multiply_plain(reg, 1.0, target_scale * dropped_prime[depth - 1] / plan.register_scale[reg]);
+            plan.register_scale[dst] = target_scale;
+            return dst;
+        };
+
+        for (size_t i = 0; i < nodes.size(); i++)
+        {
+            const Circuit_Node& node = nodes[i];
+            if (node.type == INPUT_NODE)
+            {
+                node_register[i] = new_register(0, 2, scale);
+                plan.input_registers[node.name] = node_register[i];
+                continue;
+            }
+
+            int a = node_register[node.lhs];
+            int b = node_register[node.rhs];
+
+            if (node.type == MULTIPLY_CONST_NODE)
+            {
+                node_register[i] = multiply_plain(a, node.value, dropped_prime[plan.register_depth[a]]);
+                plan.register_scale[node_register[i]] = plan.register_scale[a];
+                continue;
+            }
+            if (node.type == ADD_CONST_NODE)
+            {
+                int dst = new_register(plan.register_depth[a], plan.register_size[a], plan.register_scale[a]);
+                plan.steps.push_back(Circuit_Step{STEP_ADD_PLAIN, dst, a, -1, plan.register_depth[a], node.value,
+                                                  plan.register_scale[a]});
+                node_register[i] = dst;
+                continue;
+            }
+            if (node.type == ADD_NODE && std::abs(plan.register_scale[a] / plan.register_scale[b] - 1.0) > 1e-9)
+            {
+                if (plan.register_depth[a] < plan.register_depth[b])
+                {
+                    a = match_scale(a, plan.register_depth[b], plan.register_scale[b]);
+                }
+                else
+                {
+                    b = match_scale(b, plan.register_depth[a], plan.register_scale[a]);
+                }
+            }
+
+            size_t depth = max(plan.register_depth[a], plan.register_depth[b]);
+            a = at_depth(a, depth);
+            b = (node.type == SQUARE_NODE) ? a : at_depth(b, depth);
+
+            if (node.type == ADD_NODE)
+            {
+                if (std::abs(plan.register_scale[a] / plan.register_scale[b] - 1.0) > 1e-9)
+                {
+                    throw invalid_argument("Circuit: addition of operands at different scales");
+                }
+                int dst = new_register(depth, max(plan.register_size[a], plan.register_size[b]), plan.register_scale[a]);
+                plan.steps.push_back(Circuit_Step{STEP_ADD, dst, a, b, depth, 0, 0});
+                node_register[i] = dst;
+                continue;
+            }
+
+            /*  Lazy relinearization: only when the product would be larger than size 3  */
+            if (plan.register_size[a] + plan.register_size[b] - 1 > 3)
+            {
+                relinearize(plan.register_size[a] >= plan.register_size[b] ? a : b);
+            }
+            if (plan.register_size[a] + plan.register_size[b] - 1 > 3)
+            {
+                relinearize(plan.register_size[a] >= plan.register_size[b] ? a : b);
+            }
+
+            if (depth + 1 > max_depth)
+            {
+                throw invalid_argument("Circuit: multiplicative depth exceeds the modulus chain");
+            }
+            double product_scale = plan.register_scale[a] * plan.register_scale[b];
+            int dst = new_register(depth, plan.register_size[a] + plan.register_size[b] - 1, product_scale);
+            plan.steps.push_back(Circuit_Step{node.type == SQUARE_NODE ? STEP_SQUARE : STEP_MULTIPLY, dst, a, b, depth, 0, 0});
+
+            plan.steps.push_back(Circuit_Step{STEP_RESCALE, dst, dst, -1, depth + 1, 0, 0});
+            plan.register_depth[dst] = depth + 1;
+            plan.register_scale[dst] = product_scale / dropped_prime[depth];
+            node_register[i] = dst;
+        }
+
+        /*  Outputs are delivered at a common depth, so the decryptor sees matching parameters  */
+        for (const auto& out : outputs)
+        {
+            plan.depth = max(plan.depth, plan.register_depth[node_register[out.second]]);
+        }
+        for (const auto& out : outputs)
+        {
+            int reg = at_depth(node_register[out.second], plan.depth);
+            if (relinearize_outputs)
+            {
+                relinearize(reg);
+            }
+            plan.output_registers[out.first] = reg;
+        }
+
+        return plan;
+    }
+};
+
+inline parms_id_type parms_id_at_depth(std::shared_ptr<SEALContext> context, size_t depth)
+{
+    auto data = context->first_context_data();
+    for (size_t d = 0; d < depth; d++)
+    {
+        data = data->next_context_data();
+    }
+    return data->parms_id();
+}
+
+/*  Run a compiled plan. The inputs are consumed (moved into the registers).
+ *  encoder is needed only by plans with constants (multiply_const / add_const / scale matching).  */
+inline map<string, Ciphertext> execute_circuit(const Circuit_Plan& plan, Evaluator& evaluator,
+                                               std::shared_ptr<SEALContext> context, const RelinKeys& relin_keys,
+                                               map<string, Ciphertext>&& inputs, CKKSEncoder* encoder = nullptr)
+{
+    if (!encoder && plan.count(STEP_MULTIPLY_PLAIN) + plan.count(STEP_ADD_PLAIN) > 0)
+    {
+        throw invalid_argument("execute_circuit: the plan has constants but no encoder was given");
+    }
+
+    /*  Products, relinearizations and rescales allocate from the multiply stage's pool  */
+    MemoryPoolHandle pool = stage_pool(STAGE_MULTIPLY);
+    vector<Ciphertext> registers;
+    registers.reserve(plan.num_of_registers);
+    for (size_t i = 0; i < plan.num_of_registers; i++)
+    {
+        registers.emplace_back(pool);
+    }
+    for (const auto& in : plan.input_registers)
+    {
+        auto found = inputs.find(in.first);
+        if (found == inputs.end())
+        {
+            throw invalid_argument("execute_circuit: missing input " + in.first);
+        }
+        registers[in.second] = std::move(found->second);
+    }
+
+    for (const Circuit_Step& step : plan.steps)
+    {
+        switch (step.type)
+        {
+        case STEP_ADD:
+        {
+            /*  The plan matched the scales, so they may differ only by floating-point rounding. Anything more
+             *  is a planner bug: adding would silently mis-scale the sum.  */
+            const Ciphertext& lhs = registers[step.lhs];
+            const Ciphertext& rhs = registers[step.rhs];
+            if (!(fabs(log2(lhs.scale() / rhs.scale())) < 1e-6))
+            {
+                throw logic_error("execute_circuit: scale mismatch in an addition (" + to_string(lhs.scale()) +
+                                  " vs " + to_string(rhs.scale()) + ")");
+            }
+            if (lhs.scale() == rhs.scale())
+            {
+                evaluator.add(lhs, rhs, registers[step.dst]);
+            }
+            else
+            {
+                /*  Absorb the rounding on a copy, so that the operand register is left as it was  */
+                Ciphertext aligned(pool);
+                aligned = rhs;
+                aligned.scale() = lhs.scale();
+                evaluator.add(lhs, aligned, registers[step.dst]);
+            }
+            logrank_metrics().add.add();
+            break;
+        }
+        case STEP_MULTIPLY:
+            evaluator.multiply(registers[step.lhs], registers[step.rhs], registers[step.dst], pool);
+            logrank_metrics().multiply.add();
+            break;
+        case STEP_SQUARE:
+            evaluator.square(registers[step.lhs], registers[step.dst], pool);
+            logrank_metrics().multiply.add();
+            break;
+        case STEP_RELINEARIZE:
+            evaluator.relinearize_inplace(registers[step.dst], relin_keys, pool);
+            logrank_metrics().relinearize.add();
+            break;
+        case STEP_RESCALE:
+            evaluator.rescale_to_next_inplace(registers[step.dst], pool);
+            logrank_metrics().rescale.add();
+            break;
+        case STEP_MOD_SWITCH:
+            registers[step.dst] = registers[step.lhs];
+            evaluator.mod_switch_to_inplace(registers[step.dst], parms_id_at_depth(context, step.depth), pool);
+            break;
+        case STEP_MULTIPLY_PLAIN:
+        {
+            Plaintext constant(pool);
+            encoder->encode(step.value, registers[step.lhs].parms_id(), step.plain_scale, constant, pool);
+            evaluator.multiply_plain(registers[step.lhs], constant, registers[step.dst], pool);
+            logrank_metrics().multiply.add();
+            break;
+        }
+        case STEP_ADD_PLAIN:
+        {
+            /*  Encoded at the exact runtime scale, which the plan has tracked anyway  */
+            Plaintext constant(pool);
+            encoder->encode(step.value, registers[step.lhs].parms_id(), registers[step.lhs].scale(), constant, pool);
+            evaluator.add_plain(registers[step.lhs], constant, registers[step.dst]);
+            logrank_metrics().add.add();
+            break;
+        }
+        }
+    }
+
+    map<string, Ciphertext> outputs;
+    for (const auto& out : plan.output_registers)
+    {
+        outputs[out.first] = std::move(registers[out.second]);
+    }
+    return outputs;
+}
+
+inline void print_circuit_plan(const Circuit_Plan& plan)
+{
+    print_line(__LINE__);
+    cout << "Circuit plan: " << plan.steps.size() << " steps, depth " << plan.depth << endl;
+    cout << "    + multiplications: " << plan.count(STEP_MULTIPLY) + plan.count(STEP_SQUARE) << endl;
+    cout << "    + plaintext products: " << plan.count(STEP_MULTIPLY_PLAIN) << endl;
+    cout << "    + relinearizations: " << plan.count(STEP_RELINEARIZE) << endl;
+    cout << "    + rescales: " << plan.count(STEP_RESCALE) << endl;
+    cout << "    + mod switches: " << plan.count(STEP_MOD_SWITCH) << endl;
+    for (const auto& out : plan.output_registers)
+    {
+        cout << "    + output " << out.first << ": depth " << plan.register_depth[out.second]
+             << ", size " << plan.register_size[out.second]
+             << ", scale " << log2(plan.register_scale[out.second]) << " bits" << endl;
+    }
+}
+
+#endif // SEAL_CIRCUIT_PLANNER_H
@@ -8,6 +8,9 @@
 #include <queue>
 #include <tgmath.h>
 #include "../../../examples.h"
+#include "k_sample.h"
+#include "kaplan_meier.h"
+#include "permutation_test.h"
 #include "serv_func.h"
 
 struct Client_Input
@@ -27,6 +30,11 @@ private:
     PublicKey public_key;
     double scale;
     Client_Input input;
+    int client_id;
+
+    /*  Weighted logrank family: one (O-E) and one V term per weight function  */
+    vector<double> weighted_O_minus_E;
+    vector<double> weighted_V;
 
     /*  enc_msg_q - represents a secure one-way channel between client and evaluation server.
      *  Must be secure in case the creator server is corrupted. Assume an HTTPS connection. */
@@ -37,10 +45,11 @@ private:
 
 
 public:
-    client(std::shared_ptr<SEALContext> context_, std::shared_ptr<CKKSEncoder> encoder_, PublicKey public_key,
+    client(std::shared_ptr<SEALContext> context_, std::shared_ptr<CKKSEncoder> encoder_, const PublicKey& public_key,
            std::queue<Cipher_Msg>* enc_msg_q_, std::queue<Decrypted_Result>* decrypted_result_q_,
-           double scale_, double O, double E, double V, double r)
+           double scale_, double O, double E, double V, double r, int client_id_ = -1)
     {
+        client_id = client_id_;
         context = context_;
         encoder = encoder_;
         scale = scale_;
@@ -56,17 +65,31 @@ public:
         input.r = r;
     }
 
+    void set_input(double O, double E, double V, double r)
+    {
+        /*  The site corrected or extended its data  */
+        input.E = E;
+        input.O = O;
+        input.V = V;
+        input.r = r;
+    }
+
     void get_encryped_msg()
     {
+        Metrics_Timer timer(logrank_metrics().client_encrypt);
+
         /*  The client encodes the input    */
-        Plaintext plain_O_minus_E, plain_V, plain_r;
-        encoder->encode((input.O - input.E), scale, plain_O_minus_E);
-        encoder->encode(input.V, scale, plain_V);
+        MemoryPoolHandle pool = stage_pool(STAGE_CLIENT_ENCRYPT);
+        Plaintext plain_O_minus_E(pool), plain_V(pool), plain_r(pool);
+        encoder->encode((input.O - input.E), scale, plain_O_minus_E, pool);
+        encoder->encode(input.V, scale, plain_V, pool);
 
         /*  The client uses the public key to encrypt the input into a cipher msg   */
-        Cipher_Msg cipher;
-        encryptor->encrypt(plain_O_minus_E, cipher.enc_O_minus_E);
-        encryptor->encrypt(plain_V, cipher.enc_V);
+        Cipher_Msg cipher(pool);
+        cipher.client_id = client_id;
+        encryptor->encrypt(plain_O_minus_E, cipher.enc_O_minus_E, pool);
+        encryptor->encrypt(plain_V, cipher.enc_V, pool);
+        logrank_metrics().encrypt.add(2);
         //encryptor->encrypt(plain_r, cipher.enc_r);
 
         /* Put the ciphertext objects in exteral files - for future use
@@ -85,17 +108,124 @@ public:
 
         /* end - the position of the write ptr in the file before the write */
         end = outfile.tellp();
+        logrank_metrics().serialized_bytes.add(end - begin);
         cout << "ecryoted inputs size is: " << (end-begin) << " bytes.\n"; // The size is ~1.1M
 
 
         /*  The client uses the channel to send the cipher msg to the evaluation server  */
-        enc_msg_q->push(cipher);
+        enc_msg_q->push(std::move(cipher));
+    }
+
+    void set_weighted_input(const vector<double>& O_minus_E_w, const vector<double>& V_w)
+    {
+        weighted_O_minus_E = O_minus_E_w;
+        weighted_V = V_w;
+    }
+
+    void get_encryped_weighted_msg()
+    {
+        Metrics_Timer timer(logrank_metrics().client_encrypt);
+
+        /*  Slot k carries the terms of weight function k, so the evaluator's slot-wise sum
+         *  aggregates all the weightings at the cost of a single test  */
+        MemoryPoolHandle pool = stage_pool(STAGE_CLIENT_ENCRYPT);
+        Plaintext plain_O_minus_E(pool), plain_V(pool);
+        encoder->encode(weighted_O_minus_E, scale, plain_O_minus_E, pool);
+        encoder->encode(weighted_V, scale, plain_V, pool);
+
+        Cipher_Msg cipher(pool);
+        cipher.client_id = client_id;
+        encryptor->encrypt(plain_O_minus_E, cipher.enc_O_minus_E, pool);
+        encryptor->encrypt(plain_V, cipher.enc_V, pool);
+        logrank_metrics().encrypt.add(2);
+
+        enc_msg_q->push(std::move(cipher));
+    }
+
+    void get_encryped_k_sample_msg(const vector<double>& U, const vector<double>& V)
+    {
+        Metrics_Timer timer(logrank_metrics().client_encrypt);
+
+        /*  The whole K-sample contribution goes into enc_O_minus_E, one ciphertext per client.
+         *  enc_V is left empty and ignored by evaluator_server::evaluate_packed  */
+        MemoryPoolHandle pool = stage_pool(STAGE_CLIENT_ENCRYPT);
+        Plaintext plain_packed(pool);
+        encoder->encode(pack_k_sample_msg(U, V, encoder->slot_count()), scale, plain_packed, pool);
+
+        Cipher_Msg cipher(pool);
+        cipher.client_id = client_id;
+        encryptor->encrypt(plain_packed, cipher.enc_O_minus_E, pool);
+        logrank_metrics().encrypt.add();
+
+        enc_msg_q->push(std::move(cipher));
+    }
+
+    void get_encryped_km_msg(const vector<double>& events, const vector<double>& at_risk)
+    {
+        Metrics_Timer timer(logrank_metrics().client_encrypt);
+
+        /*  Events go in enc_O_minus_E and at-risk counts in enc_V, slot b = bin b of the chunk.
+         *  One Cipher_Msg per chunk of slot_count bins, tagged with its chunk_index.  */
+        size_t slot_count = encoder->slot_count();
+        MemoryPoolHandle pool = stage_pool(STAGE_CLIENT_ENCRYPT);
+        for (size_t chunk = 0; chunk < km_chunk_count(events.size(), slot_count); chunk++)
+        {
+            size_t from = chunk * slot_count;
+            size_t to = min(events.size(), from + slot_count);
+
+            Plaintext plain_events(pool), plain_at_risk(pool);
+            encoder->encode(vector<double>(events.begin() + from, events.begin() + to), scale, plain_events, pool);
+            encoder->encode(vector<double>(at_risk.begin() + from, at_risk.begin() + to), scale, plain_at_risk,
+                            pool);
+
+            Cipher_Msg cipher(pool);
+            cipher.client_id = client_id;
+            cipher.chunk_index = (int)chunk;
+            encryptor->encrypt(plain_events, cipher.enc_O_minus_E, pool);
+            encryptor->encrypt(plain_at_risk, cipher.enc_V, pool);
+            logrank_metrics().encrypt.add(2);
+
+            enc_msg_q->push(std::move(cipher));
+        }
+    }
+
+    void get_kaplan_meier(vector<double>& hazard, vector<double>& survival)
+    {
+        /*  Return the pooled curve (see creator_server::decrypt_chunked_msg) */
+        const Decrypted_Result& decryptedResult = decrypted_result_q->front();
+        kaplan_meier_curve(decryptedResult.D_slots, decryptedResult.U_slots, hazard, survival);
+    }
+
+    double get_k_sample_result(int K)
+    {
+        /*  Return the calculated chi-square with K-1 degrees of freedom */
+        const Decrypted_Result& decryptedResult = decrypted_result_q->front();
+        return k_sample_chi_square(decryptedResult.D_slots, K);
+    }
+
+    double get_permutation_p_value()
+    {
+        /*  Return the empirical p-value of the replicates packed by get_encryped_weighted_msg */
+        const Decrypted_Result& decryptedResult = decrypted_result_q->front();
+        return permutation_p_value(decryptedResult.D_slots, decryptedResult.U_slots);
+    }
+
+    vector<double> get_weighted_results()
+    {
+        /*  Return the calculated Z of every weight function */
+        const Decrypted_Result& decryptedResult = decrypted_result_q->front();
+        vector<double> results(decryptedResult.D_slots.size());
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            results[i] = decryptedResult.D_slots[i] / sqrt(decryptedResult.U_slots[i]);
+        }
+        return results;
     }
 
     void print_result()
     {
         /*  Print the calculated Z */
-        Decrypted_Result decryptedResult = decrypted_result_q->front();
+        const Decrypted_Result& decryptedResult = decrypted_result_q->front();
         cout << "U=" << decryptedResult.U << " D=" << decryptedResult.D << endl;
         cout << "The calculated Z is : " << (decryptedResult.D / sqrt(decryptedResult.U)) << endl;
     }
@@ -103,9 +233,15 @@ public:
     double get_result()
     {
         /*  Return the calculated Z */
-        Decrypted_Result decryptedResult = decrypted_result_q->front();
+        const Decrypted_Result& decryptedResult = decrypted_result_q->front();
         return(decryptedResult.D / sqrt(decryptedResult.U));
     }
+
+    const vector<double>& get_z_results()
+    {
+        /*  Return the Z values computed under encryption (see creator_server::decrypt_z_msg) */
+        return decrypted_result_q->front().Z_slots;
+    }
 };
 
 #endif // SEAL_CLIENT_H
@@ -0,0 +1,484 @@
+//
+// End-to-end simulation starting from raw survival records at each site.
+//
+
+#include <exception>
+#include <queue>
+#include "../../../examples.h"
+#include "client.h"
+#include "creator_server.h"
+#include "evaluator_server.h"
+#include "interim_monitor.h"
+#include "logrank_simulation.h"
+#include "survival_data_loader.h"
+#include "serv_func.h"
+using namespace std;
+using namespace seal;
+
+/*  Write a synthetic cohort: exponential survival times, hazard ratio hr for group 1, uniform censoring.
+ *  Times are rounded to days, so the data has ties like real registry data. */
+Survival_Columns sample_cohort(size_t num_of_records, double hr, unsigned int seed)
+{
+    mt19937_64 gen(seed);
+    exponential_distribution<double> base_hazard(1.0 / 365);
+    uniform_real_distribution<double> censoring(0, 5 * 365);
+    bernoulli_distribution arm(0.5);
+
+    Survival_Columns columns;
+    columns.reserve(num_of_records);
+    for (size_t i = 0; i < num_of_records; i++)
+    {
+        uint8_t group = arm(gen);
+        double t = base_hazard(gen) / (group ? hr : 1.0);
+        double c = censoring(gen);
+        columns.push_back(floor(min(t, c)) + 1, (uint8_t)(t <= c), group);
+    }
+    return columns;
+}
+
+void save_survival_csv(const string& path, const Survival_Columns& columns)
+{
+    ofstream outfile(path);
+    outfile << "time,event,group\n";
+    for (size_t i = 0; i < columns.size(); i++)
+    {
+        outfile << columns.time[i] << ',' << (int)columns.event[i] << ',' << (int)columns.group[i] << '\n';
+    }
+}
+
+void Logrank_cohort_data_sim(int num_of_clients, size_t records_per_client, bool binary_format)
+{
+    cout << " ---------------------------------" << endl;
+    cout << " ---START COHORT DATA SIMULATION---" << endl;
+    cout << " ---------------------------------" << endl;
+
+    /*  Each site keeps its records in its own file  */
+    vector<string> paths;
+    for (int i = 0; i < num_of_clients; i++)
+    {
+        Survival_Columns cohort = sample_cohort(records_per_client, 0.8, 1000 + i);
+        string path = "site_" + to_string(i) + (binary_format ? ".bin" : ".csv");
+        if (binary_format)
+        {
+            save_survival_binary(path, cohort);
+        }
+        else
+        {
+            save_survival_csv(path, cohort);
+        }
+        paths.push_back(path);
+    }
+
+    /* ------------------------------------------ */
+    /* --------------- OFFLINE PHASE -------------*/
+    /* ------------------------------------------ */
+
+    std::queue<Cipher_Msg> enc_msg_q;
+    std::queue<Decrypted_Result> decrypted_result_q;
+
+    const int scale_cost_param = 30;
+    double scale = pow(2.0, scale_cost_param);
+
+    std::shared_ptr<SEALContext> context = create_context(scale_cost_param);
+    std::shared_ptr<CKKSEncoder> encoder = create_encoder(context);
+
+    creator_server key_server(context, encoder, &decrypted_result_q);
+    evaluator_server eval_server(context, key_server.get_relin_keys(), &enc_msg_q, scale);
+
+    /* ------------------------------------------ */
+    /* --------------- DATA PREPARATION --------- */
+    /* ------------------------------------------ */
+
+    /*  Each site loads its raw records and reduces them to (O, E, V). This is measured separately
+     *  from the online phase, since it runs locally at the site before any message is sent. */
+    vector<Site_Statistics> stats(num_of_clients);
+    chrono::high_resolution_clock::time_point prep_start = chrono::high_resolution_clock::now();
+    chrono::microseconds load_time(0), compute_time(0);
+    for (int i = 0; i < num_of_clients; i++)
+    {
+        chrono::high_resolution_clock::time_point t0 = chrono::high_resolution_clock::now();
+        Survival_Columns columns = binary_format ? load_survival_binary(paths[i]) : load_survival_csv(paths[i]);
+        chrono::high_resolution_clock::time_point t1 = chrono::high_resolution_clock::now();
+        stats[i] = compute_site_statistics(columns);
+        chrono::high_resolution_clock::time_point t2 = chrono::high_resolution_clock::now();
+
+        load_time += chrono::duration_cast<chrono::microseconds>(t1 - t0);
+        compute_time += chrono::duration_cast<chrono::microseconds>(t2 - t1);
+    }
+    chrono::milliseconds prep_diff =
+        chrono::duration_cast<chrono::milliseconds>(chrono::high_resolution_clock::now() - prep_start);
+    double total_records = (double)num_of_clients * records_per_client;
+    cout << "END DATA PREPARATION [" << prep_diff.count() << " milliseconds]" << endl;
+    cout << "    + load (" << (binary_format ? "binary" : "csv") << "): " << load_time.count() / 1000 << " ms, "
+         << total_records / max(1.0, (double)load_time.count()) << " M records/sec" << endl;
+    cout << "    + O,E,V kernels: " << compute_time.count() / 1000 << " ms, "
+         << total_records / max(1.0, (double)compute_time.count()) << " M records/sec" << endl;
+
+    /*  Calculate the protocol correct output, for verification only  */
+    double sigma_O = 0, sigma_E = 0, sigma_V = 0;
+    for (int i = 0; i < num_of_clients; i++)
+    {
+        sigma_O += stats[i].O;
+        sigma_E += stats[i].E;
+        sigma_V += stats[i].V;
+    }
+    double trueResult = (sigma_O - sigma_E) / sqrt(sigma_V);
+    cout << " True value: " << trueResult << endl;
+
+    /* ------------------------------------------ */
+    /* --------------- SETTING PHASE ------------ */
+    /* ------------------------------------------ */
+
+    vector<client*> clients(num_of_clients);
+    for (int i = 0; i < num_of_clients; i++)
+    {
+        clients[i] = new client(context, encoder, key_server.get_public_key(), &enc_msg_q, &decrypted_result_q, scale,
+                                stats[i].O, stats[i].E, stats[i].V, 1.0);
+    }
+
+    /* ------------------------------------------ */
+    /* --------------- ONLINE PHASE --------------*/
+    /* ------------------------------------------ */
+
+    chrono::high_resolution_clock::time_point time_start = chrono::high_resolution_clock::now();
+
+    for (int i = 0; i < num_of_clients; i++)
+    {
+        clients[i]->get_encryped_msg();
+    }
+
+    Encrypted_Result encryptedResult = eval_server.evaluate();
+    key_server.decrypt_msg(encryptedResult);
+    clients[0]->print_result();
+    verify_result(clients[0], trueResult);
+    measure_test_time(time_start);
+
+    for (int i = 0; i < num_of_clients; i++)
+    {
+        delete clients[i];
+        remove(paths[i].c_str());
+    }
+}
+
+void example_cohort_data_test()
+{
+    Logrank_cohort_data_sim(5, 1000000, false);
+    Logrank_cohort_data_sim(5, 1000000, true);
+}
+
+void Logrank_weighted_sim(int num_of_clients, size_t records_per_client, const vector<Logrank_Weight>& weights)
+{
+    cout << " -----------------------------------" << endl;
+    cout << " ---START WEIGHTED LOGRANK SIMULATION---" << endl;
+    cout << " -----------------------------------" << endl;
+
+    std::queue<Cipher_Msg> enc_msg_q;
+    std::queue<Decrypted_Result> decrypted_result_q;
+
+    const int scale_cost_param = 30;
+    double scale = pow(2.0, scale_cost_param);
+
+    std::shared_ptr<SEALContext> context = create_context(scale_cost_param);
+    std::shared_ptr<CKKSEncoder> encoder = create_encoder(context);
+
+    creator_server key_server(context, encoder, &decrypted_result_q);
+    evaluator_server eval_server(context, key_server.get_relin_keys(), &enc_msg_q, scale);
+
+    /*  Every site computes all the weighted terms locally  */
+    vector<vector<double>> O_minus_E_w(num_of_clients), V_w(num_of_clients);
+    for (int i = 0; i < num_of_clients; i++)
+    {
+        Site_Statistics stats = compute_site_statistics(sample_cohort(records_per_client, 0.8, 2000 + i));
+        compute_weighted_statistics(stats, weights, O_minus_E_w[i], V_w[i]);
+    }
+
+    /*  Calculate the protocol correct output, for verification only  */
+    vector<double> trueResults(weights.size());
+    for (size_t k = 0; k < weights.size(); k++)
+    {
+        double sigma_O_minus_E = 0, sigma_V = 0;
+        for (int i = 0; i < num_of_clients; i++)
+        {
+            sigma_O_minus_E += O_minus_E_w[i][k];
+            sigma_V += V_w[i][k];
+        }
+        trueResults[k] = sigma_O_minus_E / sqrt(sigma_V);
+    }
+
+    vector<client*> clients(num_of_clients);
+    for (int i = 0; i < num_of_clients; i++)
+    {
+        clients[i] = new client(context, encoder, key_server.get_public_key(), &enc_msg_q, &decrypted_result_q, scale,
+                                0, 0, 0, 1.0);
+        clients[i]->set_weighted_input(O_minus_E_w[i], V_w[i]);
+    }
+
+    chrono::high_resolution_clock::time_point time_start = chrono::high_resolution_clock::now();
+
+    /*  One ciphertext pair per client carries all the weightings, and the evaluator aggregates
+     *  them with the same add_many it uses for the unweighted test  */
+    for (int i = 0; i < num_of_clients; i++)
+    {
+        clients[i]->get_encryped_weighted_msg();
+    }
+
+    Encrypted_Result encryptedResult = eval_server.evaluate();
+    key_server.decrypt_msg(encryptedResult, weights.size());
+    verify_weighted_results(clients[0], trueResults);
+    measure_test_time(time_start);
+
+    for (int i = 0; i < num_of_clients; i++)
+    {
+        delete clients[i];
+    }
+}
+
+void example_weighted_logrank_test()
+{
+    vector<Logrank_Weight> weights = {
+        {LOGRANK_WEIGHT, 0, 0},
+        {GEHAN_WEIGHT, 0, 0},
+        {TARONE_WARE_WEIGHT, 0, 0},
+        {FLEMING_HARRINGTON_WEIGHT, 0, 1},
+        {FLEMING_HARRINGTON_WEIGHT, 1, 0},
+        {FLEMING_HARRINGTON_WEIGHT, 1, 1}};
+    Logrank_weighted_sim(5, 10000, weights);
+}
+
+void Logrank_interim_monitoring_sim(int num_of_clients, size_t records_per_client, size_t num_of_windows,
+                                    const vector<size_t>& look_windows, chrono::milliseconds latency_slo)
+{
+    cout << " ---------------------------------------" << endl;
+    cout << " ---START INTERIM MONITORING SIMULATION---" << endl;
+    cout << " ---------------------------------------" << endl;
+
+    std::queue<Cipher_Msg> enc_msg_q;
+    std::queue<Decrypted_Result> decrypted_result_q;
+
+    const int scale_cost_param = 30;
+    double scale = pow(2.0, scale_cost_param);
+
+    std::shared_ptr<SEALContext> context = create_context(scale_cost_param);
+    std::shared_ptr<CKKSEncoder> encoder = create_encoder(context);
+
+    creator_server key_server(context, encoder, &decrypted_result_q);
+    evaluator_server eval_server(context, key_server.get_relin_keys(), &enc_msg_q, scale);
+    interim_monitor monitor(&eval_server, &key_server, &decrypted_result_q, look_windows, num_of_clients, latency_slo);
+
+    /*  The trial runs 5 years; accrual windows split the calendar time evenly  */
+    vector<Site_Statistics> stats(num_of_clients);
+    for (int i = 0; i < num_of_clients; i++)
+    {
+        stats[i] = compute_site_statistics(sample_cohort(records_per_client, 0.8, 4000 + i));
+    }
+    double window_length = 5 * 365.0 / num_of_windows;
+
+    vector<client*> clients(num_of_clients);
+    for (int i = 0; i < num_of_clients; i++)
+    {
+        clients[i] = new client(context, encoder, key_server.get_public_key(), &enc_msg_q, &decrypted_result_q, scale,
+                                0, 0, 0, 1.0, i);
+    }
+
+    double sigma_O = 0, sigma_E = 0, sigma_V = 0;
+    for (size_t w = 0; w < num_of_windows; w++)
+    {
+        /*  Every site sends only the delta of its window  */
+        for (int i = 0; i < num_of_clients; i++)
+        {
+            double O, E, V;
+            window_statistics(stats[i], w * window_length, (w + 1) * window_length, O, E, V);
+            sigma_O += O;
+            sigma_E += E;
+            sigma_V += V;
+            clients[i]->set_input(O, E, V, 1.0);
+            clients[i]->get_encryped_msg();
+        }
+
+        if (monitor.close_window(w))
+        {
+            verify_result(clients[0], (sigma_O - sigma_E) / sqrt(sigma_V));
+        }
+    }
+    monitor.print_latency_report();
+
+    for (int i = 0; i < num_of_clients; i++)
+    {
+        delete clients[i];
+    }
+}
+
+void example_interim_monitoring_test()
+{
+    /*  Monthly accrual windows, looks at 1/4, 1/2, 3/4 of the information and at the end  */
+    Logrank_interim_monitoring_sim(5, 10000, 60, {14, 29, 44, 59}, chrono::milliseconds(50));
+}
+
+void Logrank_permutation_sim(int num_of_clients, size_t records_per_client, size_t replicates)
+{
+    cout << " ------------------------------------" << endl;
+    cout << " ---START PERMUTATION TEST SIMULATION---" << endl;
+    cout << " ------------------------------------" << endl;
+
+    std::queue<Cipher_Msg> enc_msg_q;
+    std::queue<Decrypted_Result> decrypted_result_q;
+
+    const int scale_cost_param = 30;
+    double scale = pow(2.0, scale_cost_param);
+
+    std::shared_ptr<SEALContext> context = create_context(scale_cost_param);
+    std::shared_ptr<CKKSEncoder> encoder = create_encoder(context);
+
+    creator_server key_server(context, encoder, &decrypted_result_q);
+    evaluator_server eval_server(context, key_server.get_relin_keys(), &enc_msg_q, scale);
+
+    /*  Small sites, a handful of events each, where the normal approximation of Z is poor  */
+    vector<vector<double>> O_minus_E_b(num_of_clients), V_b(num_of_clients);
+    for (int i = 0; i < num_of_clients; i++)
+    {
+        compute_permutation_statistics(sample_cohort(records_per_client, 0.5, 5000 + i), replicates, 6000 + i,
+                                       O_minus_E_b[i], V_b[i]);
+    }
+
+    /*  Calculate the protocol correct output, for verification only  */
+    vector<double> sigma_D(replicates + 1, 0.0), sigma_U(replicates + 1, 0.0);
+    for (int i = 0; i < num_of_clients; i++)
+    {
+        for (size_t b = 0; b <= replicates; b++)
+        {
+            sigma_D[b] += O_minus_E_b[i][b];
+            sigma_U[b] += V_b[i][b];
+        }
+    }
+    double true_p = permutation_p_value(sigma_D, sigma_U);
+    double asymptotic_p = erfc(std::abs(sigma_D[0] / sqrt(sigma_U[0])) / sqrt(2.0));
+
+    vector<client*> clients(num_of_clients);
+    for (int i = 0; i < num_of_clients; i++)
+    {
+        clients[i] = new client(context, encoder, key_server.get_public_key(), &enc_msg_q, &decrypted_result_q, scale,
+                                0, 0, 0, 1.0, i);
+    }
+
+    /*  1. The single test: only the observed slot  */
+    chrono::high_resolution_clock::time_point time_start = chrono::high_resolution_clock::now();
+    for (int i = 0; i < num_of_clients; i++)
+    {
+        clients[i]->set_weighted_input({O_minus_E_b[i][0]}, {V_b[i][0]});
+        clients[i]->get_encryped_weighted_msg();
+    }
+    key_server.decrypt_msg(eval_server.evaluate(), 1);
+    chrono::microseconds single_time =
+        chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - time_start);
+
+    /*  2. The observed slot and all the replicates, in the same ciphertext pair per client  */
+    time_start = chrono::high_resolution_clock::now();
+    for (int i = 0; i < num_of_clients; i++)
+    {
+        clients[i]->set_weighted_input(O_minus_E_b[i], V_b[i]);
+        clients[i]->get_encryped_weighted_msg();
+    }
+    key_server.decrypt_msg(eval_server.evaluate(), replicates + 1);
+    double p = clients[0]->get_permutation_p_value();
+    chrono::microseconds permutation_time =
+        chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - time_start);
+
+    cout << "Observed Z = " << sigma_D[0] / sqrt(sigma_U[0]) << ", asymptotic p = " << asymptotic_p << endl;
+    cout << "Permutation p over " << replicates << " replicates = " << p << " (true " << true_p << ")" << endl;
+    cout << "    + single test: " << single_time.count() / 1000 << " ms" << endl;
+    cout << "    + with " << replicates << " replicates: " << permutation_time.count() / 1000 << " ms" << endl;
+    if (std::abs(p - true_p) > 2.0 / (replicates + 1))
+    {
+        cout << "---- ERROR!! ----- the p-value gap is : " << std::abs(p - true_p) << endl;
+        throw;
+    }
+
+    for (int i = 0; i < num_of_clients; i++)
+    {
+        delete clients[i];
+    }
+}
+
+void example_permutation_logrank_test()
+{
+    /*  Sites the size of the Mainz examples: a dozen patients, 0-6 events each  */
+    Logrank_permutation_sim(5, 12, 4095);
+}
+
+void Logrank_kaplan_meier_sim(int num_of_clients, size_t records_per_client, double bin_width, size_t num_of_bins)
+{
+    cout << " ----------------------------------" << endl;
+    cout << " ---START KAPLAN-MEIER SIMULATION---" << endl;
+    cout << " ----------------------------------" << endl;
+
+    std::queue<Cipher_Msg> enc_msg_q;
+    std::queue<Decrypted_Result> decrypted_result_q;
+
+    const int scale_cost_param = 30;
+    double scale = pow(2.0, scale_cost_param);
+
+    std::shared_ptr<SEALContext> context = create_context(scale_cost_param);
+    std::shared_ptr<CKKSEncoder> encoder = create_encoder(context);
+
+    creator_server key_server(context, encoder, &decrypted_result_q);
+    evaluator_server eval_server(context, key_server.get_relin_keys(), &enc_msg_q, scale);
+
+    /*  Every site bins its own records. The pooled counts in the clear are for verification only  */
+    vector<vector<double>> events(num_of_clients), at_risk(num_of_clients);
+    vector<double> pooled_events(num_of_bins, 0.0), pooled_at_risk(num_of_bins, 0.0);
+    for (int i = 0; i < num_of_clients; i++)
+    {
+        compute_km_bin_counts(sample_cohort(records_per_client, 0.8, 7000 + i), bin_width, num_of_bins,
+                              events[i], at_risk[i]);
+        for (size_t b = 0; b < num_of_bins; b++)
+        {
+            pooled_events[b] += events[i][b];
+            pooled_at_risk[b] += at_risk[i][b];
+        }
+    }
+    vector<double> true_hazard, true_survival;
+    kaplan_meier_curve(pooled_events, pooled_at_risk, true_hazard, true_survival);
+
+    vector<client*> clients(num_of_clients);
+    for (int i = 0; i < num_of_clients; i++)
+    {
+        clients[i] = new client(context, encoder, key_server.get_public_key(), &enc_msg_q, &decrypted_result_q, scale,
+                                0, 0, 0, 1.0, i);
+    }
+
+    chrono::high_resolution_clock::time_point time_start = chrono::high_resolution_clock::now();
+    for (int i = 0; i < num_of_clients; i++)
+    {
+        clients[i]->get_encryped_km_msg(events[i], at_risk[i]);
+    }
+    key_server.decrypt_chunked_msg(eval_server.evaluate_chunked(), num_of_bins);
+
+    vector<double> hazard, survival;
+    clients[0]->get_kaplan_meier(hazard, survival);
+    measure_test_time(time_start);
+
+    double max_gap = 0;
+    for (size_t b = 0; b < num_of_bins; b++)
+    {
+        max_gap = max(max_gap, std::abs(survival[b] - true_survival[b]));
+    }
+    cout << num_of_bins << " bins in " << km_chunk_count(num_of_bins, encoder->slot_count()) << " chunks, S(end) = "
+         << survival.back() << " (true " << true_survival.back() << "), max gap " << max_gap << endl;
+    if (max_gap > 1e-9)
+    {
+        cout << "---- ERROR!! ----- the survival curves differ" << endl;
+        throw;
+    }
+
+    for (int i = 0; i < num_of_clients; i++)
+    {
+        delete clients[i];
+    }
+}
+
+void example_kaplan_meier_test()
+{
+    /*  Daily bins over 5 years fit one ciphertext; 6-hour bins need two  */
+    Logrank_kaplan_meier_sim(5, 10000, 1.0, 5 * 365);
+    Logrank_kaplan_meier_sim(5, 10000, 0.25, 4 * 5 * 365);
+}
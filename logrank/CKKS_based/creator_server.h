@@ -6,6 +6,7 @@
 #define SEAL_CREATOR_SERVER_H
 
 #include "../../../examples.h"
+#include "circuit_planner.h"
 #include "client.h"
 #include "serv_func.h"
 
@@ -15,13 +16,27 @@ private:
     std::shared_ptr<SEALContext> context;
     std::shared_ptr<CKKSEncoder> encoder;
     Decryptor* decryptor;
+    KeyGenerator* keygen;
 
     /*  decrypted_result_q - represents an unsecure one-way channel between decryption sever and clients.  */
     std::queue<Decrypted_Result>* decrypted_result_q;
 
     SecretKey secret_key;
     PublicKey public_key;
+
+    /*  Expanded on the first get_relin_keys(); the key bundle path never needs them here  */
     RelinKeys relin_keys;
+    bool relin_keys_ready = false;
+
+    /*  A result holds at most slot_count slots per ciphertext  */
+    void check_num_of_slots(const string& caller, size_t num_of_slots, size_t num_of_ciphertexts = 1) const
+    {
+        if (num_of_slots > num_of_ciphertexts * encoder->slot_count())
+        {
+            throw invalid_argument(caller + ": " + to_string(num_of_slots) + " slots requested, the result has " +
+                                   to_string(num_of_ciphertexts * encoder->slot_count()));
+        }
+    }
 
 public:
     creator_server(std::shared_ptr<SEALContext> context_, std::shared_ptr<CKKSEncoder> encoder_,
@@ -42,39 +57,71 @@ public:
     ~creator_server()
     {
         delete decryptor;
+        delete keygen;
     }
 
     void create_all_keys()
     {
-        KeyGenerator keygen(context);
-        public_key = keygen.public_key();
-        secret_key = keygen.secret_key();
-        relin_keys = keygen.relin_keys_local();
+        keygen = new KeyGenerator(context);
+        public_key = keygen->public_key();
+        secret_key = keygen->secret_key();
     }
 
-    PublicKey get_public_key()
+    const PublicKey& get_public_key() const
     {
         return public_key;
     }
 
-    RelinKeys get_relin_keys()
+    const RelinKeys& get_relin_keys()
     {
+        if (!relin_keys_ready)
+        {
+            relin_keys = keygen->relin_keys_local();
+            relin_keys_ready = true;
+        }
         return relin_keys;
     }
 
-    void decrypt_msg(Encrypted_Result encryptedResult)
+    /*  The keys an evaluator running `plans` needs, serialized for the wire: the seeded relin keys if any plan
+     *  relinearizes, nothing otherwise. The evaluator expands them (evaluator_server's bundle constructor).  */
+    Evaluator_Key_Bundle create_evaluator_key_bundle(const vector<const Circuit_Plan*>& plans)
+    {
+        Evaluator_Key_Bundle bundle;
+        bool needs_relin_keys = false;
+        for (const Circuit_Plan* plan : plans)
+        {
+            needs_relin_keys = needs_relin_keys || plan->needs_relin_keys();
+        }
+        if (needs_relin_keys)
+        {
+            stringstream stream;
+            keygen->relin_keys().save(stream);
+            bundle.relin_keys = stream.str();
+        }
+        logrank_metrics().serialized_bytes.add(bundle.size());
+        return bundle;
+    }
+
+    /*  num_of_slots - how many leading slots of D and U to return. The scalar protocol uses one slot,
+     *  the weighted logrank family uses one slot per weight function.  */
+    void decrypt_msg(const Encrypted_Result& encryptedResult, size_t num_of_slots = 1)
     {
+        check_num_of_slots("decrypt_msg", num_of_slots);
+        Metrics_Timer timer(logrank_metrics().creator_decrypt);
+
         /*  1. Decryption: */
-        Plaintext D_plain;
-        Plaintext U_plain;
+        MemoryPoolHandle pool = stage_pool(STAGE_DECRYPT);
+        Plaintext D_plain(pool);
+        Plaintext U_plain(pool);
 
         decryptor->decrypt(encryptedResult.D_encrypted, D_plain);
         decryptor->decrypt(encryptedResult.U_encrypted, U_plain);
+        logrank_metrics().decrypt.add(2);
 
         /*  2. Decode: */
         vector <double> D_result, U_result;
-        encoder->decode(D_plain, D_result);
-        encoder->decode(U_plain, U_result);
+        encoder->decode(D_plain, D_result, pool);
+        encoder->decode(U_plain, U_result, pool);
 
         /*  3. Print part of the decoded vectors, for sainety-check.
          *     All values in a vector should be equal  */
@@ -88,6 +135,8 @@ public:
         Decrypted_Result result;
         result.D = d;
         result.U = u;
+        result.D_slots.assign(D_result.begin(), D_result.begin() + num_of_slots);
+        result.U_slots.assign(U_result.begin(), U_result.begin() + num_of_slots);
 
         /*  5. The creator server is responsible to empty the decrypted_result_q.
          *      For simplicity, we empty the queue at the just before pushing a new msg.
@@ -97,7 +146,98 @@ public:
             decrypted_result_q->pop();
         }
 
-        decrypted_result_q->push(result);
+        decrypted_result_q->push(std::move(result));
+    }
+
+    /*  Z computed under encryption: only Z is decrypted, so the pooled D and U stay hidden  */
+    void decrypt_z_msg(const Encrypted_Result& encryptedResult, size_t num_of_slots = 1)
+    {
+        check_num_of_slots("decrypt_z_msg", num_of_slots);
+        Metrics_Timer timer(logrank_metrics().creator_decrypt);
+
+        MemoryPoolHandle pool = stage_pool(STAGE_DECRYPT);
+        Plaintext Z_plain(pool);
+        decryptor->decrypt(encryptedResult.Z_encrypted, Z_plain);
+        logrank_metrics().decrypt.add();
+
+        vector <double> Z_result;
+        encoder->decode(Z_plain, Z_result, pool);
+        print_vector(Z_result, 3, 7);
+
+        Decrypted_Result result;
+        result.D = 0;
+        result.U = 0;
+        result.Z = Z_result[0];
+        result.Z_slots.assign(Z_result.begin(), Z_result.begin() + num_of_slots);
+
+        while(!decrypted_result_q->empty())
+        {
+            decrypted_result_q->pop();
+        }
+
+        decrypted_result_q->push(std::move(result));
+    }
+
+    /*  Chunked results (see evaluator_server::evaluate_chunked): the slots of all the chunks are
+     *  concatenated into D_slots and U_slots, num_of_slots in total.  */
+    void decrypt_chunked_msg(const vector<Encrypted_Result>& encryptedResults, size_t num_of_slots)
+    {
+        check_num_of_slots("decrypt_chunked_msg", num_of_slots, encryptedResults.size());
+        Metrics_Timer timer(logrank_metrics().creator_decrypt);
+
+        Decrypted_Result result;
+        MemoryPoolHandle pool = stage_pool(STAGE_DECRYPT);
+        for (const Encrypted_Result& chunk : encryptedResults)
+        {
+            Plaintext D_plain(pool), U_plain(pool);
+            decryptor->decrypt(chunk.D_encrypted, D_plain);
+            decryptor->decrypt(chunk.U_encrypted, U_plain);
+            logrank_metrics().decrypt.add(2);
+
+            vector <double> D_result, U_result;
+            encoder->decode(D_plain, D_result, pool);
+            encoder->decode(U_plain, U_result, pool);
+
+            size_t take = min(D_result.size(), num_of_slots - result.D_slots.size());
+            result.D_slots.insert(result.D_slots.end(), D_result.begin(), D_result.begin() + take);
+            result.U_slots.insert(result.U_slots.end(), U_result.begin(), U_result.begin() + take);
+        }
+        result.D = result.D_slots.empty() ? 0 : result.D_slots[0];
+        result.U = result.U_slots.empty() ? 0 : result.U_slots[0];
+
+        while(!decrypted_result_q->empty())
+        {
+            decrypted_result_q->pop();
+        }
+
+        decrypted_result_q->push(std::move(result));
+    }
+
+    void decrypt_packed_msg(const Encrypted_Result& encryptedResult, size_t num_of_slots)
+    {
+        check_num_of_slots("decrypt_packed_msg", num_of_slots);
+        Metrics_Timer timer(logrank_metrics().creator_decrypt);
+
+        /*  Packed results carry everything in D_encrypted (see evaluator_server::evaluate_packed)  */
+        MemoryPoolHandle pool = stage_pool(STAGE_DECRYPT);
+        Plaintext D_plain(pool);
+        decryptor->decrypt(encryptedResult.D_encrypted, D_plain);
+        logrank_metrics().decrypt.add();
+
+        vector <double> D_result;
+        encoder->decode(D_plain, D_result, pool);
+
+        Decrypted_Result result;
+        result.D = D_result[0];
+        result.U = 0;
+        result.D_slots.assign(D_result.begin(), D_result.begin() + num_of_slots);
+
+        while(!decrypted_result_q->empty())
+        {
+            decrypted_result_q->pop();
+        }
+
+        decrypted_result_q->push(std::move(result));
     }
 };
 
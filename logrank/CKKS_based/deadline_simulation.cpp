@@ -0,0 +1,141 @@
+//
+// Deadline-based partial aggregation with late-arrival merging.
+//
+
+#include <exception>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include "../../../examples.h"
+#include "client.h"
+#include "creator_server.h"
+#include "evaluator_server.h"
+#include "logrank_simulation.h"
+#include "serv_func.h"
+using namespace std;
+using namespace seal;
+
+void Logrank_deadline_sim(int num_of_clients, int num_of_stragglers, int deadline_ms)
+{
+    cout << " -------------------------------" << endl;
+    cout << " ---START DEADLINE SIMULATION---" << endl;
+    cout << " -------------------------------" << endl;
+
+    /* ------------------------------------------ */
+    /* --------------- OFFLINE PHASE -------------*/
+    /* ------------------------------------------ */
+
+    /*  enc_msg_q is written by the clients' uploads while the evaluator reads it, so it is guarded  */
+    std::queue<Cipher_Msg> enc_msg_q;
+    std::mutex enc_msg_q_mutex;
+    std::queue<Decrypted_Result> decrypted_result_q;
+
+    const int scale_cost_param = 30;
+    double scale = pow(2.0, scale_cost_param);
+
+    std::shared_ptr<SEALContext> context = create_context(scale_cost_param);
+    std::shared_ptr<CKKSEncoder> encoder = create_encoder(context);
+
+    vector<ClientsInput> inputs(num_of_clients);
+    sample_inputs_clients(inputs.data(), num_of_clients);
+
+    double sigma_O = 0, sigma_E = 0, sigma_V = 0;
+    for (int i=0; i<num_of_clients; i++)
+    {
+        sigma_O += inputs[i].O;
+        sigma_E += inputs[i].E;
+        sigma_V += inputs[i].V;
+    }
+    double trueResult = ((sigma_O - sigma_E) / sqrt(sigma_V));
+    cout << " True value: " << trueResult << endl;
+
+    creator_server key_server(context, encoder, &decrypted_result_q);
+    evaluator_server eval_server(context, key_server.get_relin_keys(), &enc_msg_q, scale);
+    eval_server.set_channel_mutex(&enc_msg_q_mutex);
+
+    /* ------------------------------------------ */
+    /* --------------- SETTING PHASE ------------ */
+    /* ------------------------------------------ */
+
+    /*  Each client encrypts into its own outbox. The upload (outbox -> enc_msg_q) is a separate thread
+     *  with a network delay; the last num_of_stragglers clients upload only after the deadline.  */
+    vector<std::queue<Cipher_Msg>> outbox(num_of_clients);
+    vector<client*> clients(num_of_clients);
+    for (int i=0; i<num_of_clients; i++)
+    {
+        clients[i] = new client(context, encoder, key_server.get_public_key(), &outbox[i], &decrypted_result_q, scale,
+                                inputs[i].O, inputs[i].E, inputs[i].V, inputs[i].r, i);
+    }
+
+    /* ------------------------------------------ */
+    /* --------------- ONLINE PHASE --------------*/
+    /* ------------------------------------------ */
+
+    chrono::high_resolution_clock::time_point time_start = chrono::high_resolution_clock::now();
+    for (int i=0; i<num_of_clients; i++)
+    {
+        clients[i]->get_encryped_msg();
+    }
+
+    /*  The deadline counts from the start of the uploads, so the encryption above does not eat into it.
+     *  Every upload is due at a fixed offset from the same start: the on-time clients within the first half
+     *  of the window, the stragglers a full window after the deadline.  */
+    chrono::steady_clock::time_point upload_start = chrono::steady_clock::now();
+    chrono::steady_clock::time_point deadline = upload_start + chrono::milliseconds(deadline_ms);
+
+    vector<thread> uploads;
+    for (int i=0; i<num_of_clients; i++)
+    {
+        bool straggler = (i >= num_of_clients - num_of_stragglers);
+        chrono::milliseconds offset(straggler ? 2 * deadline_ms : rand() % max(1, deadline_ms / 2));
+        chrono::steady_clock::time_point due = upload_start + offset;
+        uploads.emplace_back([&, i, due]() {
+            std::this_thread::sleep_until(due);
+            std::lock_guard<std::mutex> lock(enc_msg_q_mutex);
+            enc_msg_q.push(std::move(outbox[i].front()));
+            outbox[i].pop();
+        });
+    }
+
+    /*  1. Provisional result at the deadline  */
+    Provisional_Result provisional = eval_server.evaluate_by_deadline(deadline, num_of_clients);
+    if (provisional.no_contributors)
+    {
+        cout << "No client arrived by the deadline" << endl;
+    }
+    else
+    {
+        key_server.decrypt_msg(provisional.result);
+        cout << "Provisional result from clients:";
+        for (int id : provisional.contributors)
+        {
+            cout << " " << id;
+        }
+        cout << (provisional.complete ? " (complete)" : " (partial)") << endl;
+        clients[0]->print_result();
+    }
+    measure_test_time(time_start);
+
+    /*  2. The stragglers arrive and are merged into the stored accumulator  */
+    for (thread& t : uploads)
+    {
+        t.join();
+    }
+    Provisional_Result final_result = eval_server.merge_late_arrivals(num_of_clients);
+    key_server.decrypt_msg(final_result.result);
+    cout << "Final result from " << final_result.contributors.size() << " clients"
+         << (final_result.complete ? " (complete)" : " (partial)") << endl;
+    clients[0]->print_result();
+    verify_result(clients[0], trueResult);
+    measure_test_time(time_start);
+
+    for (int i=0; i<num_of_clients; i++)
+    {
+        delete clients[i];
+    }
+}
+
+void example_deadline_logrank_test()
+{
+    Logrank_deadline_sim(20, 3, 200);
+}
@@ -0,0 +1,370 @@
+//
+// Crash-consistent checkpoints of the evaluator's running accumulator.
+//
+
+#ifndef SEAL_EVALUATOR_CHECKPOINT_H
+#define SEAL_EVALUATOR_CHECKPOINT_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include "../../../examples.h"
+#include "serv_func.h"
+
+/*  Checkpoint log. Each record is self-contained:
+ *      [uint32 magic][uint64 payload size][uint64 FNV-1a of payload][payload]
+ *      payload = [uint8 full][uint64 merged_count][uint64 n][int32 client_id * n]
+ *                [uint8 present][uint64 size][ciphertext]   for enc_O_minus_E, enc_V, enc_r
+ *  The first record of a file is full: it lists every contributor. The records appended after it list only
+ *  the clients merged since the previous record. A record is written with a single write() (retried on a
+ *  short or interrupted write), and the log is fsync'ed every records_per_fsync records.
+ *
+ *  Once a file holds records_per_file records, the next record goes to a new file instead: a full record is
+ *  written to path.tmp, fsync'ed and renamed over path. Recovery then reads at most records_per_file records,
+ *  whatever the length of the study. A crash can only leave a torn record at the tail of the file (the
+ *  rename is atomic); recovery takes the last record whose checksum matches, so the restored state is
+ *  always one that was fully written.  */
+static const uint32_t CHECKPOINT_MAGIC = 0x4c52434b; // "LRCK"
+
+struct Evaluator_Checkpoint
+{
+    Cipher_Msg accumulator;
+    set<int> contributors;
+    uint64_t merged_count = 0;
+};
+
+namespace checkpoint_detail
+{
+    inline uint64_t fnv1a(const string& data)
+    {
+        uint64_t hash = 1469598103934665603ULL;
+        for (unsigned char c : data)
+        {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    template <typename T>
+    inline void put(std::ostream& stream, const T& value)
+    {
+        stream.write((const char*)&value, sizeof(T));
+    }
+
+    template <typename T>
+    inline bool get(std::istream& stream, T& value)
+    {
+        return (bool)stream.read((char*)&value, sizeof(T));
+    }
+
+    inline void put_cipher(std::ostream& stream, const Ciphertext& cipher)
+    {
+        uint8_t present = (cipher.size() != 0);
+        put(stream, present);
+        if (!present)
+        {
+            return;
+        }
+        std::stringstream bytes;
+        cipher.save(bytes);
+        string data = bytes.str();
+        put(stream, (uint64_t)data.size());
+        stream.write(data.data(), data.size());
+    }
+
+    inline bool get_cipher(std::istream& stream, std::shared_ptr<SEALContext> context, Ciphertext& cipher)
+    {
+        uint8_t present = 0;
+        if (!get(stream, present))
+        {
+            return false;
+        }
+        if (!present)
+        {
+            cipher = Ciphertext();
+            return true;
+        }
+        uint64_t size = 0;
+        if (!get(stream, size))
+        {
+            return false;
+        }
+        string data(size, '\0');
+        if (!stream.read(&data[0], size))
+        {
+            return false;
+        }
+        std::stringstream bytes(data);
+        cipher.load(context, bytes);
+        return true;
+    }
+
+    /*  Write all of data to fd, retrying short and interrupted writes  */
+    inline void write_all(int fd, const string& data, const string& path)
+    {
+        const char* next = data.data();
+        size_t left = data.size();
+        while (left > 0)
+        {
+            ssize_t written = ::write(fd, next, left);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                throw runtime_error("checkpoint_log: write failed on " + path + ": " + strerror(errno));
+            }
+            next += written;
+            left -= written;
+        }
+    }
+
+    inline void sync_fd(int fd, const string& path)
+    {
+        while (::fsync(fd) != 0)
+        {
+            if (errno != EINTR)
+            {
+                throw runtime_error("checkpoint_log: fsync failed on " + path + ": " + strerror(errno));
+            }
+        }
+    }
+
+    /*  Make a rename in the directory of path durable  */
+    inline void sync_parent_dir(const string& path)
+    {
+        size_t slash = path.rfind('/');
+        string dir = (slash == string::npos) ? "." : path.substr(0, max((size_t)1, slash));
+        int dir_fd = ::open(dir.c_str(), O_RDONLY);
+        if (dir_fd < 0)
+        {
+            throw runtime_error("checkpoint_log: cannot open directory " + dir);
+        }
+        try
+        {
+            sync_fd(dir_fd, dir);
+        }
+        catch (...)
+        {
+            ::close(dir_fd);
+            throw;
+        }
+        ::close(dir_fd);
+    }
+}
+
+class checkpoint_log
+{
+private:
+    string path;
+    int fd = -1;
+    size_t records_per_fsync;
+    size_t records_per_file;
+    size_t records_in_file = 0;
+    size_t unsynced_records = 0;
+
+    static string make_record(bool full, const Cipher_Msg& accumulator, const vector<int>& client_ids,
+                              uint64_t merged_count)
+    {
+        using namespace checkpoint_detail;
+
+        std::stringstream payload_stream;
+        put(payload_stream, (uint8_t)full);
+        put(payload_stream, merged_count);
+        put(payload_stream, (uint64_t)client_ids.size());
+        for (int id : client_ids)
+        {
+            put(payload_stream, (int32_t)id);
+        }
+        put_cipher(payload_stream, accumulator.enc_O_minus_E);
+        put_cipher(payload_stream, accumulator.enc_V);
+        put_cipher(payload_stream, accumulator.enc_r);
+        string payload = payload_stream.str();
+
+        std::stringstream record;
+        put(record, CHECKPOINT_MAGIC);
+        put(record, (uint64_t)payload.size());
+        put(record, fnv1a(payload));
+        record.write(payload.data(), payload.size());
+        return record.str();
+    }
+
+    /*  Start a new file holding the full record only, and replace the log with it  */
+    void rotate(const string& record)
+    {
+        using namespace checkpoint_detail;
+
+        string tmp_path = path + ".tmp";
+        int tmp_fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        if (tmp_fd < 0)
+        {
+            throw runtime_error("checkpoint_log: cannot open " + tmp_path);
+        }
+        try
+        {
+            write_all(tmp_fd, record, tmp_path);
+            sync_fd(tmp_fd, tmp_path);
+        }
+        catch (...)
+        {
+            ::close(tmp_fd);
+            throw;
+        }
+        if (::rename(tmp_path.c_str(), path.c_str()) != 0)
+        {
+            ::close(tmp_fd);
+            throw runtime_error("checkpoint_log: cannot rename " + tmp_path + " to " + path);
+        }
+        sync_parent_dir(path);
+
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        fd = tmp_fd;
+        ::lseek(fd, 0, SEEK_END);
+        records_in_file = 1;
+        unsynced_records = 0;
+    }
+
+public:
+    /*  The file at path is only replaced by the first append, so a crash before it keeps the old log  */
+    checkpoint_log(const string& path_, size_t records_per_fsync_, size_t records_per_file_ = 16)
+    {
+        path = path_;
+        records_per_fsync = max((size_t)1, records_per_fsync_);
+        records_per_file = max((size_t)1, records_per_file_);
+    }
+
+    ~checkpoint_log()
+    {
+        if (fd >= 0)
+        {
+            try
+            {
+                sync();
+            }
+            catch (const exception& e)
+            {
+                cerr << e.what() << endl;
+            }
+            ::close(fd);
+        }
+    }
+
+    checkpoint_log(const checkpoint_log&) = delete;
+    checkpoint_log& operator=(const checkpoint_log&) = delete;
+
+    /*  contributors - every client in the accumulator, written when the log starts a new file.
+     *  new_clients - the clients merged since the previous append, written otherwise.  */
+    void append(const Cipher_Msg& accumulator, const set<int>& contributors, const vector<int>& new_clients,
+                uint64_t merged_count)
+    {
+        string record;
+        if (fd < 0 || records_in_file >= records_per_file)
+        {
+            record = make_record(true, accumulator, vector<int>(contributors.begin(), contributors.end()),
+                                 merged_count);
+            rotate(record);
+        }
+        else
+        {
+            record = make_record(false, accumulator, new_clients, merged_count);
+            checkpoint_detail::write_all(fd, record, path);
+            records_in_file++;
+            if (++unsynced_records >= records_per_fsync)
+            {
+                sync();
+            }
+        }
+        logrank_metrics().serialized_bytes.add(record.size());
+    }
+
+    void sync()
+    {
+        if (unsynced_records > 0)
+        {
+            checkpoint_detail::sync_fd(fd, path);
+            unsynced_records = 0;
+        }
+    }
+
+    /*  Restore the last complete record of the log at path, with the contributors of every record up to it.
+     *  Returns false if there is none.  */
+    static bool load_latest(const string& path, std::shared_ptr<SEALContext> context, Evaluator_Checkpoint& checkpoint)
+    {
+        using namespace checkpoint_detail;
+
+        std::ifstream infile(path, std::ifstream::binary);
+        if (!infile)
+        {
+            return false;
+        }
+
+        string latest;
+        set<int> contributors;
+        uint64_t merged_count = 0;
+        bool found = false;
+        while (true)
+        {
+            uint32_t magic;
+            uint64_t size, checksum;
+            if (!get(infile, magic) || !get(infile, size) || !get(infile, checksum) || magic != CHECKPOINT_MAGIC)
+            {
+                break;
+            }
+            string payload(size, '\0');
+            if (!infile.read(&payload[0], size) || fnv1a(payload) != checksum)
+            {
+                /*  Torn tail record  */
+                break;
+            }
+
+            std::stringstream fields(payload);
+            uint8_t full = 0;
+            uint64_t n = 0;
+            get(fields, full);
+            if (!found && !full)
+            {
+                throw runtime_error("checkpoint_log: " + path + " does not start with a full record");
+            }
+            get(fields, merged_count);
+            get(fields, n);
+            for (uint64_t i = 0; i < n; i++)
+            {
+                int32_t id;
+                get(fields, id);
+                contributors.insert(id);
+            }
+            latest.swap(payload);
+            found = true;
+        }
+        if (!found)
+        {
+            return false;
+        }
+
+        /*  The ciphertexts of the last record only; skip its header and client ids  */
+        std::stringstream payload(latest);
+        uint8_t full = 0;
+        uint64_t n = 0;
+        get(payload, full);
+        get(payload, checkpoint.merged_count);
+        get(payload, n);
+        payload.seekg(n * sizeof(int32_t), std::ios::cur);
+        checkpoint.contributors = std::move(contributors);
+        return get_cipher(payload, context, checkpoint.accumulator.enc_O_minus_E) &&
+               get_cipher(payload, context, checkpoint.accumulator.enc_V) &&
+               get_cipher(payload, context, checkpoint.accumulator.enc_r);
+    }
+};
+
+#endif // SEAL_EVALUATOR_CHECKPOINT_H
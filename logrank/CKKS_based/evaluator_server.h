@@ -5,127 +5,275 @@
 #ifndef SEAL_EVALUATOR_SERVER_H
 #define SEAL_EVALUATOR_SERVER_H
 
+#include <exception>
+#include <mutex>
+#include <map>
 #include <queue>
+#include <set>
+#include <thread>
 #include "../../../examples.h"
+#include "circuit_planner.h"
+#include "evaluator_checkpoint.h"
+#include "inverse_sqrt.h"
 #include "serv_func.h"
+#include "spool.h"
+
+/*  The randomized statistic: D = T0 x R, U = T1 x R^2  */
+inline Circuit build_random_circuit()
+{
+    Circuit random_circuit;
+    int R = random_circuit.input("R");
+    int T0 = random_circuit.input("T0");
+    int T1 = random_circuit.input("T1");
+    random_circuit.output("D", random_circuit.multiply(T0, R));
+    random_circuit.output("U", random_circuit.multiply(T1, random_circuit.square(R)));
+    return random_circuit;
+}
+
+/*  How the running accumulator is fed. An evaluator uses one of them: mixing would count a site twice
+ *  (a site update cannot subtract a msg that merge_arrivals added).  */
+enum Merge_Mode
+{
+    MERGE_NONE = 0,
+    MERGE_ARRIVALS = 1,        // merge_arrivals: one msg per client
+    MERGE_DELTAS = 2,          // merge_deltas: every msg of a client is added
+    MERGE_SITE_UPDATES = 3     // apply_site_updates: a msg replaces the site's previous one
+};
 
 class evaluator_server
 {
 private:
     RelinKeys relin_keys;
+    bool has_relin_keys = false;
     std::shared_ptr<SEALContext> context;
     Evaluator* evaluator;
     double scale;
+    Circuit_Plan random_plan;
 
     /*  enc_msg_q - represents a secure one-way channel between client and evaluation server.
      *  Must be secure in case the creator server is corrupted. Assume an HTTPS connection. */
     std::queue<Cipher_Msg>* enc_msg_q;
 
-public:
-    evaluator_server(std::shared_ptr<SEALContext> context_, RelinKeys relin_keys_,
-                     std::queue<Cipher_Msg>* enc_msg_q_, double scale_)
+    /*  enc_msg_q_mutex - set when clients upload concurrently with the evaluation (deadline mode)  */
+    std::mutex* enc_msg_q_mutex = nullptr;
+
+    /*  Running accumulator of the incremental modes: the field-wise sum of every msg merged so far  */
+    Cipher_Msg accumulator;
+    set<int> contributors;
+    size_t merged_count = 0;
+
+    /*  The last contribution of every site, keyed by client_id (site-update mode only)  */
+    map<int, Cipher_Msg> site_contributions;
+    Merge_Mode merge_mode = MERGE_NONE;
+
+    /*  Checkpointing of the accumulator (see evaluator_checkpoint.h)  */
+    checkpoint_log* checkpoints = nullptr;
+    size_t checkpoint_interval = 0;
+    size_t merged_since_checkpoint = 0;
+    vector<int> unlogged_clients;    // merged since the last checkpoint record
+
+    vector<Cipher_Msg> drain_channel()
     {
-        relin_keys = relin_keys_;
-        context = context_;
-        scale = scale_;
-        enc_msg_q = enc_msg_q_;
+        vector<Cipher_Msg> msg_vec;
+        std::unique_lock<std::mutex> lock;
+        if (enc_msg_q_mutex)
+        {
+            lock = std::unique_lock<std::mutex>(*enc_msg_q_mutex);
+        }
+        while(!enc_msg_q->empty())
+        {
+            msg_vec.push_back(std::move(enc_msg_q->front()));
+            enc_msg_q->pop();
+        }
+        return msg_vec;
+    }
 
-        /*  Create a Evaluator object.
-         *  Evaluator object is used in the Online Phase of the protocol   */
-        evaluator = new Evaluator(context);
+    void enter_merge_mode(Merge_Mode mode, const string& caller)
+    {
+        if (merge_mode != MERGE_NONE && merge_mode != mode)
+        {
+            throw logic_error(caller + ": this evaluator already merges msgs in another mode");
+        }
+        merge_mode = mode;
     }
-    ~evaluator_server()
+
+    /*  The level a result leaves the evaluator at  */
+    void record_level(const Ciphertext& result)
     {
-        delete evaluator;
+        if (result.size() != 0)
+        {
+            logrank_metrics().result_chain_index.set(context->get_context_data(result.parms_id())->chain_index());
+        }
     }
 
-    Encrypted_Result evaluate_with_random()
+    /*  Add the msgs in the channel to the accumulator. A msg without a client_id (< 0) is dropped; so is a
+     *  msg from a client that already contributed, unless repeats_are_deltas.  */
+    size_t merge_channel(bool repeats_are_deltas)
     {
-        /*  Read all the cipher msgs from all clients.
-         *  We assume that when this method is called all the clients already put their msgs in the queue  */
-        vector<Cipher_Msg> msg_vec;
-        while(!enc_msg_q->empty())
+        Metrics_Timer timer(logrank_metrics().evaluator_merge);
+        vector<Cipher_Msg> msg_vec = drain_channel();
+        size_t merged = 0;
+        for (Cipher_Msg& msg : msg_vec)
         {
-            msg_vec.push_back(enc_msg_q->front());
-            enc_msg_q->pop();
+            if (msg.client_id < 0)
+            {
+                logrank_metrics().rejected_msgs.add(1);
+                cout << "Dropped a msg without a client_id" << endl;
+                continue;
+            }
+            if (!repeats_are_deltas && contributors.count(msg.client_id))
+            {
+                logrank_metrics().rejected_msgs.add(1);
+                continue;
+            }
+            bool first_msg = contributors.insert(msg.client_id).second;
+            if (checkpoints && first_msg)
+            {
+                unlogged_clients.push_back(msg.client_id);
+            }
+            accumulate_field(accumulator.enc_O_minus_E, std::move(msg.enc_O_minus_E));
+            accumulate_field(accumulator.enc_V, std::move(msg.enc_V));
+            accumulate_field(accumulator.enc_r, std::move(msg.enc_r));
+            merged_count++;
+            merged++;
+
+            if (checkpoints && ++merged_since_checkpoint >= checkpoint_interval)
+            {
+                checkpoint();
+            }
         }
+        return merged;
+    }
 
-        /*  Reorder the cipher elements  */
-        Basic_Vectors basicVectors = create_basic_vectors(msg_vec);
+    void accumulate_field(Ciphertext& sum, Ciphertext&& addend)
+    {
+        if (addend.size() == 0)
+        {
+            return;
+        }
+        if (sum.size() == 0)
+        {
+            /*  The first addend is copied into the aggregation pool (once per running sum), so a long-lived
+             *  sum never keeps the arena of the client stage alive  */
+            sum = Ciphertext(stage_pool(STAGE_AGGREGATE));
+            sum = addend;
+        }
+        else
+        {
+            evaluator->add_inplace(sum, addend);
+            logrank_metrics().add.add();
+        }
+    }
 
-        /*  Compute R  */
-        Ciphertext sigma_r_encrypted;
-        calculate_R(*evaluator, basicVectors, sigma_r_encrypted);
+    void add_field(Ciphertext& sum, const Ciphertext& addend)
+    {
+        if (addend.size() == 0)
+        {
+            return;
+        }
+        if (sum.size() == 0)
+        {
+            sum = Ciphertext(stage_pool(STAGE_AGGREGATE));
+            sum = addend;
+        }
+        else
+        {
+            evaluator->add_inplace(sum, addend);
+            logrank_metrics().add.add();
+        }
+    }
 
-        /*  Compute T0  */
-        Ciphertext sigma_T0_encrypted;
-        calculate_T0(*evaluator, basicVectors, sigma_T0_encrypted);
+    void sub_field(Ciphertext& sum, const Ciphertext& subtrahend)
+    {
+        if (subtrahend.size() != 0)
+        {
+            evaluator->sub_inplace(sum, subtrahend);
+            logrank_metrics().add.add();
+        }
+    }
 
-        /*  Compute T1  */
-        Ciphertext sigma_T1_encrypted;
-        calculate_T1(*evaluator, basicVectors, sigma_T1_encrypted);
+    void init(std::shared_ptr<SEALContext> context_, std::queue<Cipher_Msg>* enc_msg_q_, double scale_)
+    {
+        context = context_;
+        scale = scale_;
+        enc_msg_q = enc_msg_q_;
 
-        /*  Compute D = T0 x R  . Then relinearize and rescale. */
-        Encrypted_Result output;
-        multiply_relinearize_and_rescale(*evaluator, sigma_T0_encrypted, sigma_r_encrypted,
-                                                   output.D_encrypted, "D", relin_keys);
+        /*  Create a Evaluator object.
+         *  Evaluator object is used in the Online Phase of the protocol   */
+        evaluator = new Evaluator(context);
 
-        /*  Compute R x R . Then relinearize and rescale.  */
-        Ciphertext R_sq_encrypted;
-        square_relinearize_and_rescale(*evaluator, sigma_r_encrypted,
-                                                 R_sq_encrypted, "R", relin_keys);
+        random_plan = build_random_circuit().compile(context, scale);
+    }
 
-        /*  Now R_sq_encrypted is at a different level than sigma_T1_encrypted, which prevents us
-            from multiplying them to compute U = T1*R*R.    */
+    void require_relin_keys(const char* caller) const
+    {
+        if (!has_relin_keys)
+        {
+            throw logic_error(string(caller) + ": the evaluator's key bundle has no relinearization keys");
+        }
+    }
 
-        print_line(__LINE__);
-        cout << "Parameters used by all three terms are different." << endl;
-        cout << "    + Modulus chain index for sigma_T1_encrypted: "
-             << context->get_context_data(sigma_T1_encrypted.parms_id())->chain_index() << endl;
-        cout << "    + Modulus chain index for R_sq_encrypted: "
-             << context->get_context_data(R_sq_encrypted.parms_id())->chain_index() << endl;
-        cout << "    + R_sq_encrypted::save_size: "
-             << R_sq_encrypted.save_size() << endl;
-        cout << "    + sigma_T1_encrypted::save_size: "
-             << sigma_T1_encrypted.save_size() << endl;
-        cout << endl;
+public:
+    /*  relin_keys_ is taken by value and moved in: the evaluator owns its keys (in a deployment they arrive
+     *  over the wire), and a caller that no longer needs its copy can std::move it in.  */
+    evaluator_server(std::shared_ptr<SEALContext> context_, RelinKeys relin_keys_,
+                     std::queue<Cipher_Msg>* enc_msg_q_, double scale_)
+    {
+        relin_keys = std::move(relin_keys_);
+        has_relin_keys = true;
+        init(context_, enc_msg_q_, scale_);
+    }
 
-        /*  We could simply switch sigma_T1_encrypted to the next parameters in the modulus switching chain.
-            However, we need to make sure the scale are the same for both of them (they both are very close to 30,
-            but not exactly 30). So we align the scale by  using the SEAL function .scale() */
+    /*  Setup from the wire (creator_server::create_evaluator_key_bundle): the seeded relin keys, if any,
+     *  are expanded here. Without them only the aggregation modes are available.  */
+    evaluator_server(std::shared_ptr<SEALContext> context_, const Evaluator_Key_Bundle& keys,
+                     std::queue<Cipher_Msg>* enc_msg_q_, double scale_)
+    {
+        if (!keys.relin_keys.empty())
+        {
+            stringstream stream(keys.relin_keys);
+            relin_keys.load(context_, stream);
+            has_relin_keys = true;
+        }
+        init(context_, enc_msg_q_, scale_);
+    }
 
-        print_line(__LINE__);
-        cout << "Normalize scales to 2^30." << endl;
-        sigma_T1_encrypted.scale() = scale;
-        R_sq_encrypted.scale() = scale;
-        cout << "    + R_sq_encrypted::save_size: "
-             << R_sq_encrypted.save_size() << endl;
+    const Circuit_Plan& get_random_plan() const
+    {
+        return random_plan;
+    }
+    ~evaluator_server()
+    {
+        delete checkpoints;
+        delete evaluator;
+    }
 
-        /*  " We still have a problem with mismatching encryption parameters. This is easy
-            to fix by using traditional modulus switching (no rescaling). CKKS supports
-            modulus switching just like the BFV scheme, allowing us to switch away parts
-            of the coefficient modulus when it is simply not needed. " (SEAL comment)   */
+    Encrypted_Result evaluate_with_random()
+    {
+        Metrics_Timer timer(logrank_metrics().evaluator_evaluate);
+        require_relin_keys("evaluate_with_random");
 
-        print_line(__LINE__);
-        cout << "Normalize encryption parameters to the lowest level." << endl;
-        parms_id_type last_parms_id = R_sq_encrypted.parms_id();
-        evaluator->mod_switch_to_inplace(sigma_T1_encrypted, last_parms_id);
+        /*  Read all the cipher msgs from all clients.
+         *  We assume that when this method is called all the clients already put their msgs in the queue  */
+        vector<Cipher_Msg> msg_vec = drain_channel();
 
-        /*  Now, when the scale and the Modulus chain index are equal for  sigma_T1_encrypted
-         *  and R_sq_encrypted, we can multiply them. */
-        print_line(__LINE__);
-        cout << "Compute and rescale U = T1*R*R." << endl;
-        multiply_relinearize_and_rescale(*evaluator, sigma_T1_encrypted, R_sq_encrypted,
-                                                   output.U_encrypted, "U", relin_keys);
+        /*  Reorder the cipher elements  */
+        Basic_Vectors basicVectors = create_basic_vectors(std::move(msg_vec));
 
-        /*  Now D and U are ready. However, there is a problem:
-            the encryption parameters used by D and U are different due to modulus switching from rescaling.
+        /*  Compute R, T0 and T1  */
+        map<string, Ciphertext> inputs;
+        calculate_R(*evaluator, basicVectors, inputs["R"]);
+        calculate_T0(*evaluator, basicVectors, inputs["T0"]);
+        calculate_T1(*evaluator, basicVectors, inputs["T1"]);
 
-            Before decryption we want to align the scales and the encryption parameters (parms_id) match,
-            to avoid unexpected consequences.   */
+        /*  Compute D = T0 x R and U = T1 x R x R with the compiled plan. The plan places the mod switches
+         *  and relinearizations and tracks the exact scales, so D and U come out at the same level.  */
+        print_circuit_plan(random_plan);
+        map<string, Ciphertext> outputs = execute_circuit(random_plan, *evaluator, context, relin_keys, std::move(inputs));
 
-        last_parms_id = output.U_encrypted.parms_id();
-        evaluator->mod_switch_to_inplace(output.D_encrypted, last_parms_id);
+        Encrypted_Result output;
+        output.D_encrypted = std::move(outputs["D"]);
+        output.U_encrypted = std::move(outputs["U"]);
 
         cout << endl;
         print_line(__LINE__);
@@ -138,22 +286,20 @@ public:
         cout << "    + Exact scale in  U_encrypted: " << output.U_encrypted.scale() << endl;
         cout << endl;
 
+        record_level(output.D_encrypted);
         return output;
     }
 
     Encrypted_Result evaluate()
     {
+        Metrics_Timer timer(logrank_metrics().evaluator_evaluate);
+
         /*  Read all the cipher msgs from all clients.
          *  We assume that when this method is called all the clients already put their msgs in the queue  */
-        vector<Cipher_Msg> msg_vec;
-        while(!enc_msg_q->empty())
-        {
-            msg_vec.push_back(enc_msg_q->front());
-            enc_msg_q->pop();
-        }
+        vector<Cipher_Msg> msg_vec = drain_channel();
 
         /*  Reorder the cipher elements  */
-        Basic_Vectors basicVectors = create_basic_vectors(msg_vec);
+        Basic_Vectors basicVectors = create_basic_vectors(std::move(msg_vec));
 
         Encrypted_Result output;
 
@@ -189,8 +335,309 @@ public:
 
         /* end - the position of the write ptr in the file before the write */
         end = outfile.tellp();
+        logrank_metrics().serialized_bytes.add(end - begin);
         cout << "encrypted result size is: " << (end-begin) << " bytes.\n"; // The size is ~1.1M
 
+        record_level(output.D_encrypted);
+        return output;
+    }
+
+    void set_channel_mutex(std::mutex* enc_msg_q_mutex_)
+    {
+        enc_msg_q_mutex = enc_msg_q_mutex_;
+    }
+
+    /*  Add every msg currently in the channel to the accumulator. Each msg is added exactly once,
+     *  so merging late arrivals never reprocesses the earlier ciphertexts. A client contributes once:
+     *  a resend (or a resend of a client restored from a checkpoint) is dropped.  */
+    size_t merge_arrivals()
+    {
+        enter_merge_mode(MERGE_ARRIVALS, "merge_arrivals");
+        return merge_channel(false);
+    }
+
+    /*  As merge_arrivals, for clients that send a delta of their sums every window (interim monitoring):
+     *  every msg of a client is added.  */
+    size_t merge_deltas()
+    {
+        enter_merge_mode(MERGE_DELTAS, "merge_deltas");
+        return merge_channel(true);
+    }
+
+    /*  Append the accumulator and the newly processed client ids to a checkpoint log every checkpoint_interval_
+     *  merged msgs. A crash loses at most checkpoint_interval_ msgs of work, which the clients resend.
+     *  The log starts a new file every records_per_file records, which bounds the recovery time.  */
+    void enable_checkpoints(const string& path, size_t checkpoint_interval_, size_t records_per_fsync = 1,
+                            size_t records_per_file = 16)
+    {
+        delete checkpoints;
+        checkpoints = new checkpoint_log(path, records_per_fsync, records_per_file);
+        checkpoint_interval = max((size_t)1, checkpoint_interval_);
+        merged_since_checkpoint = 0;
+        unlogged_clients.clear();
+    }
+
+    void checkpoint()
+    {
+        if (checkpoints)
+        {
+            checkpoints->append(accumulator, contributors, unlogged_clients, merged_count);
+            unlogged_clients.clear();
+            merged_since_checkpoint = 0;
+        }
+    }
+
+    /*  Resume after a restart from the last complete record of the log. Returns false (and keeps an empty
+     *  accumulator) if there is no checkpoint. The clients that are not in get_contributors() must resend.  */
+    bool restore_from_checkpoint(const string& path)
+    {
+        if (merge_mode == MERGE_SITE_UPDATES)
+        {
+            throw logic_error("restore_from_checkpoint: the site contributions are not checkpointed");
+        }
+        Evaluator_Checkpoint restored;
+        if (!checkpoint_log::load_latest(path, context, restored))
+        {
+            return false;
+        }
+        accumulator = std::move(restored.accumulator);
+        contributors = std::move(restored.contributors);
+        merged_count = restored.merged_count;
+
+        print_line(__LINE__);
+        cout << "Restored checkpoint: " << merged_count << " msgs from " << contributors.size() << " clients" << endl;
+        return true;
+    }
+
+    const set<int>& get_contributors() const
+    {
+        return contributors;
+    }
+
+    /*  The current sums as a result (D = sigma T0, U = sigma T1), tagged with the contributing clients.
+     *  The accumulator is kept, so the result is a copy. Before the first msg is merged there are no sums:
+     *  the result is marked no_contributors and holds no ciphertexts, and must not be decrypted.  */
+    Provisional_Result get_provisional_result(size_t expected_clients)
+    {
+        Provisional_Result provisional;
+        provisional.no_contributors = (accumulator.enc_O_minus_E.size() == 0);
+        if (!provisional.no_contributors)
+        {
+            provisional.result.D_encrypted = accumulator.enc_O_minus_E;
+            provisional.result.U_encrypted = accumulator.enc_V;
+        }
+        provisional.contributors = contributors;
+        provisional.complete = !provisional.no_contributors && (contributors.size() >= expected_clients);
+        return provisional;
+    }
+
+    /*  Deadline mode: aggregate whatever has arrived by the cutoff instead of waiting for every client.
+     *  Returns early if all the expected clients arrived before the deadline.  */
+    Provisional_Result evaluate_by_deadline(chrono::steady_clock::time_point deadline, size_t expected_clients,
+                                            chrono::milliseconds poll_interval = chrono::milliseconds(5))
+    {
+        while (true)
+        {
+            merge_arrivals();
+            if (contributors.size() >= expected_clients || chrono::steady_clock::now() >= deadline)
+            {
+                break;
+            }
+            std::this_thread::sleep_for(min(poll_interval,
+                chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now())));
+        }
+
+        print_line(__LINE__);
+        cout << "Deadline aggregation: " << contributors.size() << " of " << expected_clients
+             << " clients contributed" << endl;
+        return get_provisional_result(expected_clients);
+    }
+
+    /*  Merge the stragglers into the stored accumulator and release the updated result  */
+    Provisional_Result merge_late_arrivals(size_t expected_clients)
+    {
+        size_t merged = merge_arrivals();
+        print_line(__LINE__);
+        cout << "Merged " << merged << " late arrivals: " << contributors.size() << " of " << expected_clients
+             << " clients contributed" << endl;
+        return get_provisional_result(expected_clients);
+    }
+
+    /*  Site-update mode: the evaluator keeps each site's last contribution. A msg from a site that already
+     *  contributed replaces its old one by a homomorphic subtract-old / add-new on the accumulator, so a
+     *  refresh of D and U costs O(changed sites) instead of re-summing every site. A msg without a
+     *  client_id (< 0) is dropped, as there is no site to replace.  */
+    size_t apply_site_updates()
+    {
+        /*  A restored accumulator has no site contributions to subtract  */
+        if (merge_mode == MERGE_NONE && merged_count > 0)
+        {
+            throw logic_error("apply_site_updates: the accumulator was not built by site updates");
+        }
+        enter_merge_mode(MERGE_SITE_UPDATES, "apply_site_updates");
+        Metrics_Timer timer(logrank_metrics().evaluator_merge);
+
+        vector<Cipher_Msg> msg_vec = drain_channel();
+        size_t applied = 0;
+        for (Cipher_Msg& msg : msg_vec)
+        {
+            if (msg.client_id < 0)
+            {
+                logrank_metrics().rejected_msgs.add(1);
+                cout << "Dropped a site update without a client_id" << endl;
+                continue;
+            }
+            auto previous = site_contributions.find(msg.client_id);
+            if (previous != site_contributions.end())
+            {
+                sub_field(accumulator.enc_O_minus_E, previous->second.enc_O_minus_E);
+                sub_field(accumulator.enc_V, previous->second.enc_V);
+                sub_field(accumulator.enc_r, previous->second.enc_r);
+            }
+            add_field(accumulator.enc_O_minus_E, msg.enc_O_minus_E);
+            add_field(accumulator.enc_V, msg.enc_V);
+            add_field(accumulator.enc_r, msg.enc_r);
+
+            contributors.insert(msg.client_id);
+            site_contributions[msg.client_id] = std::move(msg);
+            applied++;
+        }
+        merged_count += applied;
+        return applied;
+    }
+
+    /*  Out-of-core evaluation: D = sigma(O-E) and U = sigma(V) over every upload in the spool directory.
+     *  Each of num_threads threads takes every num_threads-th file, keeps only its partial sums and the msg
+     *  being loaded in memory, and prefetches the next prefetch_depth files while it adds the current one.
+     *  The partial sums are added at the end, so memory is O(num_threads) ciphertexts whatever the number of
+     *  uploads. Evaluator::add_inplace is const, so the threads share one evaluator. A worker that fails stops
+     *  at its current file; the first failure is rethrown once every worker has been joined.  */
+    Encrypted_Result evaluate_from_spool(const string& spool_dir, size_t num_threads, size_t prefetch_depth = 4)
+    {
+        Metrics_Timer timer(logrank_metrics().evaluator_evaluate);
+        vector<string> files = list_spool(spool_dir);
+        num_threads = max((size_t)1, min(num_threads, files.size()));
+
+        vector<Cipher_Msg> partial(num_threads);
+        vector<std::exception_ptr> failures(num_threads);
+        vector<thread> workers;
+        for (size_t t = 0; t < num_threads; t++)
+        {
+            workers.emplace_back([&, t]() {
+                try
+                {
+                    for (size_t i = t; i < min(files.size(), t + prefetch_depth * num_threads); i += num_threads)
+                    {
+                        spool_file::prefetch(files[i]);
+                    }
+                    for (size_t i = t; i < files.size(); i += num_threads)
+                    {
+                        size_t ahead = i + prefetch_depth * num_threads;
+                        if (ahead < files.size())
+                        {
+                            spool_file::prefetch(files[ahead]);
+                        }
+                        Cipher_Msg msg;
+                        {
+                            spool_file file(files[i]);
+                            file.load(context, msg);
+                        }
+                        accumulate_field(partial[t].enc_O_minus_E, std::move(msg.enc_O_minus_E));
+                        accumulate_field(partial[t].enc_V, std::move(msg.enc_V));
+                    }
+                }
+                catch (...)
+                {
+                    failures[t] = std::current_exception();
+                }
+            });
+        }
+        for (thread& worker : workers)
+        {
+            worker.join();
+        }
+        for (const std::exception_ptr& failure : failures)
+        {
+            if (failure)
+            {
+                std::rethrow_exception(failure);
+            }
+        }
+
+        Encrypted_Result output;
+        for (Cipher_Msg& sums : partial)
+        {
+            accumulate_field(output.D_encrypted, std::move(sums.enc_O_minus_E));
+            accumulate_field(output.U_encrypted, std::move(sums.enc_V));
+        }
+
+        print_line(__LINE__);
+        cout << "Spool evaluation: " << files.size() << " uploads with " << num_threads << " threads" << endl;
+        record_level(output.D_encrypted);
+        return output;
+    }
+
+    /*  Z = D / sqrt(U) under encryption (see inverse_sqrt.h). The aggregated D and U never leave the
+     *  evaluator; only Z is released to the creator server. The context needs plan.depth levels.  */
+    Encrypted_Result evaluate_z(const Inverse_Sqrt_Plan& plan)
+    {
+        Metrics_Timer timer(logrank_metrics().evaluator_evaluate);
+        require_relin_keys("evaluate_z");
+        vector<Cipher_Msg> msg_vec = drain_channel();
+        Basic_Vectors basicVectors = create_basic_vectors(std::move(msg_vec));
+
+        map<string, Ciphertext> inputs;
+        calculate_T0(*evaluator, basicVectors, inputs["D"]);
+        calculate_T1(*evaluator, basicVectors, inputs["U"]);
+
+        Circuit_Plan z_plan = build_z_circuit(plan).compile(context, scale, true);
+        print_circuit_plan(z_plan);
+
+        CKKSEncoder encoder(context);
+        map<string, Ciphertext> outputs =
+            execute_circuit(z_plan, *evaluator, context, relin_keys, std::move(inputs), &encoder);
+
+        Encrypted_Result output;
+        output.Z_encrypted = std::move(outputs["Z"]);
+        record_level(output.Z_encrypted);
+        return output;
+    }
+
+    /*  Multi-ciphertext messages: one add_many per chunk_index over all the clients. Result k holds
+     *  chunk k (D_encrypted = sigma enc_O_minus_E, U_encrypted = sigma enc_V).  */
+    vector<Encrypted_Result> evaluate_chunked()
+    {
+        Metrics_Timer timer(logrank_metrics().evaluator_evaluate);
+        map<int, vector<Cipher_Msg>> chunks;
+        for (Cipher_Msg& msg : drain_channel())
+        {
+            chunks[msg.chunk_index].push_back(std::move(msg));
+        }
+
+        vector<Encrypted_Result> output(chunks.empty() ? 0 : chunks.rbegin()->first + 1);
+        for (auto& chunk : chunks)
+        {
+            Basic_Vectors basicVectors = create_basic_vectors(std::move(chunk.second));
+            calculate_T0(*evaluator, basicVectors, output[chunk.first].D_encrypted);
+            calculate_T1(*evaluator, basicVectors, output[chunk.first].U_encrypted);
+            record_level(output[chunk.first].D_encrypted);
+        }
+        return output;
+    }
+
+    Encrypted_Result evaluate_packed()
+    {
+        /*  Single-ciphertext messages (e.g. the K-sample layout): every statistic lives in the slots of
+         *  enc_O_minus_E, so one add_many aggregates them all. The result is returned in D_encrypted. */
+        Metrics_Timer timer(logrank_metrics().evaluator_evaluate);
+        vector<Cipher_Msg> msg_vec = drain_channel();
+
+        Basic_Vectors basicVectors = create_basic_vectors(std::move(msg_vec));
+
+        Encrypted_Result output;
+        calculate_T0(*evaluator, basicVectors, output.D_encrypted);
+
+        record_level(output.D_encrypted);
         return output;
     }
 
@@ -0,0 +1,152 @@
+//
+// Hierarchical aggregation: clients -> regional aggregators -> ... -> evaluator_server.
+//
+
+#include <exception>
+#include <queue>
+#include <thread>
+#include "../../../examples.h"
+#include "aggregator_server.h"
+#include "creator_server.h"
+#include "evaluator_server.h"
+#include "logrank_simulation.h"
+#include "serv_func.h"
+using namespace std;
+using namespace seal;
+
+/*  randomized - the clients also upload enc_r, and the root runs evaluate_with_random  */
+void Logrank_hierarchical_sim(int num_of_clients, int fan_out, bool randomized)
+{
+    cout << " -----------------------------------" << endl;
+    cout << " ---START HIERARCHICAL SIMULATION---" << endl;
+    cout << " -----------------------------------" << endl;
+
+    if (fan_out < 2)
+    {
+        throw invalid_argument("Logrank_hierarchical_sim: fan_out must be at least 2");
+    }
+
+    /* ------------------------------------------ */
+    /* --------------- OFFLINE PHASE -------------*/
+    /* ------------------------------------------ */
+
+    /*  enc_msg_q - the root channel, into the evaluator_server  */
+    std::queue<Cipher_Msg> enc_msg_q;
+    std::queue<Decrypted_Result> decrypted_result_q;
+
+    const int scale_cost_param = 30;
+    double scale = pow(2.0, scale_cost_param);
+
+    std::shared_ptr<SEALContext> context = create_context(scale_cost_param);
+    std::shared_ptr<CKKSEncoder> encoder = create_encoder(context);
+
+    vector<ClientsInput> inputs(num_of_clients);
+    sample_inputs_clients(inputs.data(), num_of_clients);
+
+    double sigma_O = 0, sigma_E = 0, sigma_V = 0;
+    for (int i=0; i<num_of_clients; i++)
+    {
+        sigma_O += inputs[i].O;
+        sigma_E += inputs[i].E;
+        sigma_V += inputs[i].V;
+    }
+    double trueResult = ((sigma_O - sigma_E) / sqrt(sigma_V));
+    cout << " True value: " << trueResult << endl;
+
+    creator_server key_server(context, encoder, &decrypted_result_q);
+    evaluator_server eval_server(context, key_server.get_relin_keys(), &enc_msg_q, scale);
+
+    /* ------------------------------------------ */
+    /* --------------- SETTING PHASE ------------ */
+    /* ------------------------------------------ */
+
+    /*  The leaf level: client i uploads to leaf aggregator i / fan_out.
+     *  Every node of the tree owns its ingress channel.  */
+    size_t num_of_leaves = (num_of_clients + fan_out - 1) / fan_out;
+    vector<std::queue<Cipher_Msg>> level_q(num_of_leaves);
+    Encryptor encryptor(context, key_server.get_public_key());
+
+    /* ------------------------------------------ */
+    /* --------------- ONLINE PHASE --------------*/
+    /* ------------------------------------------ */
+
+    chrono::high_resolution_clock::time_point time_start = chrono::high_resolution_clock::now();
+
+    /*  The uploads carry enc_r, which the aggregators sum like the other fields  */
+    for (int i=0; i<num_of_clients; i++)
+    {
+        Cipher_Msg msg = create_encrypted_msg(*encoder, encryptor, scale, inputs[i].O, inputs[i].E, inputs[i].V,
+                                              inputs[i].r);
+        msg.client_id = i;
+        level_q[i / fan_out].push(std::move(msg));
+    }
+
+    /*  Aggregate level by level. The aggregators of a level run in parallel, each on its own thread,
+     *  and each forwards one partial sum to its parent. The last level forwards into enc_msg_q.  */
+    size_t max_node_ingress = fan_out;
+    int level = 0;
+    while (true)
+    {
+        size_t num_of_nodes = level_q.size();
+        bool is_top = (num_of_nodes <= (size_t)fan_out);
+        vector<std::queue<Cipher_Msg>> parent_q(is_top ? 0 : (num_of_nodes + fan_out - 1) / fan_out);
+
+        /*  std::queue is not thread safe and siblings share a parent channel, so each aggregator uploads into
+         *  its own buffer, which is delivered to the parent once the whole level finished  */
+        vector<std::queue<Cipher_Msg>> upload_q(num_of_nodes);
+        vector<aggregator_server*> aggregators(num_of_nodes);
+        vector<thread> threads;
+        for (size_t a = 0; a < num_of_nodes; a++)
+        {
+            aggregators[a] = new aggregator_server(context, &level_q[a], &upload_q[a]);
+            threads.emplace_back(&aggregator_server::aggregate, aggregators[a]);
+        }
+        for (thread& t : threads)
+        {
+            t.join();
+        }
+        for (size_t a = 0; a < num_of_nodes; a++)
+        {
+            max_node_ingress = max(max_node_ingress, aggregators[a]->get_ingress_count());
+            std::queue<Cipher_Msg>& destination = is_top ? enc_msg_q : parent_q[a / fan_out];
+            while (!upload_q[a].empty())
+            {
+                destination.push(std::move(upload_q[a].front()));
+                upload_q[a].pop();
+            }
+            delete aggregators[a];
+        }
+
+        cout << "Aggregation level " << level << ": " << num_of_nodes << " aggregators" << endl;
+        level++;
+        if (is_top)
+        {
+            break;
+        }
+        level_q = std::move(parent_q);
+    }
+
+    size_t root_ingress = enc_msg_q.size();
+
+    Encrypted_Result encryptedResult = randomized ? eval_server.evaluate_with_random() : eval_server.evaluate();
+    key_server.decrypt_msg(encryptedResult);
+    double Z = decrypted_result_q.front().D / sqrt(decrypted_result_q.front().U);
+    cout << " Z at the root (" << (randomized ? "evaluate_with_random" : "evaluate") << "): " << Z << endl;
+    if (std::abs((Z - trueResult) / trueResult) > 0.001)
+    {
+        cout << "---- ERROR!! ----- the gap is : " << std::abs((Z - trueResult) / trueResult) << endl;
+        throw;
+    }
+    measure_test_time(time_start);
+
+    cout << "Root ingress: " << root_ingress << " msgs (flat protocol: " << num_of_clients << " msgs), "
+         << level << " aggregation levels, fan-out " << fan_out
+         << ", max aggregator ingress " << max_node_ingress << " msgs" << endl;
+}
+
+void example_hierarchical_logrank_test()
+{
+    Logrank_hierarchical_sim(100, 10, false);
+    Logrank_hierarchical_sim(1000, 16, false);
+    Logrank_hierarchical_sim(100, 10, true);
+}
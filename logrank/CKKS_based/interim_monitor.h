@@ -0,0 +1,112 @@
+//
+// Continuous interim-analysis monitoring for group-sequential trials.
+//
+
+#ifndef SEAL_INTERIM_MONITOR_H
+#define SEAL_INTERIM_MONITOR_H
+
+#include <chrono>
+#include <set>
+#include <vector>
+#include "../../../examples.h"
+#include "creator_server.h"
+#include "evaluator_server.h"
+#include "serv_func.h"
+
+struct Interim_Look
+{
+    size_t window;
+    double D;
+    double U;
+    double Z;
+    size_t contributors;
+    chrono::microseconds latency;
+};
+
+/*  The monitor runs the protocol as a long-lived process. Clients send the encrypted delta of (O-E, V)
+ *  for every accrual window, the evaluator keeps the rolling encrypted totals (merge_deltas), and the
+ *  creator server decrypts only at the scheduled looks. The work per window is one addition per new msg,
+ *  so the cost of a look is proportional to what changed since the previous one.  */
+class interim_monitor
+{
+private:
+    evaluator_server* eval_server;
+    creator_server* key_server;
+    std::queue<Decrypted_Result>* decrypted_result_q;
+
+    set<size_t> scheduled_looks;
+    size_t expected_clients;
+    chrono::microseconds latency_slo;
+
+    vector<Interim_Look> looks;
+
+public:
+    interim_monitor(evaluator_server* eval_server_, creator_server* key_server_,
+                    std::queue<Decrypted_Result>* decrypted_result_q_, const vector<size_t>& look_windows,
+                    size_t expected_clients_, chrono::microseconds latency_slo_)
+    {
+        eval_server = eval_server_;
+        key_server = key_server_;
+        decrypted_result_q = decrypted_result_q_;
+        scheduled_looks.insert(look_windows.begin(), look_windows.end());
+        expected_clients = expected_clients_;
+        latency_slo = latency_slo_;
+    }
+
+    /*  Called when accrual window `window` closes and its deltas are in the channel.
+     *  Returns true if a look was taken.  */
+    bool close_window(size_t window)
+    {
+        chrono::high_resolution_clock::time_point time_start = chrono::high_resolution_clock::now();
+        eval_server->merge_deltas();
+        if (scheduled_looks.count(window) == 0)
+        {
+            return false;
+        }
+
+        Provisional_Result totals = eval_server->get_provisional_result(expected_clients);
+        if (totals.no_contributors)
+        {
+            print_line(__LINE__);
+            cout << "Interim look at window " << window << " skipped: no site has reported yet" << endl;
+            return false;
+        }
+        key_server->decrypt_msg(totals.result);
+        const Decrypted_Result& decrypted = decrypted_result_q->front();
+
+        Interim_Look look;
+        look.window = window;
+        look.D = decrypted.D;
+        look.U = decrypted.U;
+        look.Z = decrypted.D / sqrt(decrypted.U);
+        look.contributors = totals.contributors.size();
+        look.latency = chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - time_start);
+        looks.push_back(look);
+
+        print_line(__LINE__);
+        cout << "Interim look at window " << window << ": Z = " << look.Z << " (" << look.contributors
+             << " sites, " << look.latency.count() / 1000.0 << " ms"
+             << (look.latency > latency_slo ? ", SLO MISSED" : "") << ")" << endl;
+        return true;
+    }
+
+    const vector<Interim_Look>& get_looks() const
+    {
+        return looks;
+    }
+
+    void print_latency_report() const
+    {
+        size_t missed = 0;
+        chrono::microseconds worst(0);
+        for (const Interim_Look& look : looks)
+        {
+            missed += (look.latency > latency_slo);
+            worst = max(worst, look.latency);
+        }
+        cout << "Interim looks: " << looks.size() << ", worst latency " << worst.count() / 1000.0 << " ms, SLO "
+             << latency_slo.count() / 1000.0 << " ms, missed " << missed << endl;
+    }
+};
+
+#endif // SEAL_INTERIM_MONITOR_H
@@ -0,0 +1,130 @@
+//
+// Z = D / sqrt(U) under encryption: a depth-planned inverse square root for CKKS.
+//
+
+#ifndef SEAL_INVERSE_SQRT_H
+#define SEAL_INVERSE_SQRT_H
+
+#include <cmath>
+#include <stdexcept>
+#include "../../../examples.h"
+#include "circuit_planner.h"
+
+/*  CKKS has no division or square root, so 1/sqrt(U) is approximated on a public range [U_min, U_max]
+ *  (from the study design, e.g. the number of sites and events per site):
+ *      u  = U / U_max  in  [U_min / U_max, 1]
+ *      y0 = a + b u                              (least-squares fit of 1/sqrt(u), relative error weighted)
+ *      y  <- y (3 - u y^2) / 2                   (Newton, the error squares at every step)
+ *      Z  = (D / sqrt(U_max)) y
+ *  The initial guess costs one level, every Newton step two, and the final product one.
+ *  Newton converges only if u y0^2 < 3 on the whole range, which limits how wide the range can be.  */
+struct Inverse_Sqrt_Plan
+{
+    double U_min;
+    double U_max;
+    double a;
+    double b;
+    size_t iterations;
+    double max_rel_error;   // of the approximation alone, over the range
+    size_t depth;           // of Z
+};
+
+inline double approximate_inverse_sqrt(double u, double a, double b, size_t iterations)
+{
+    double y = a + b * u;
+    for (size_t i = 0; i < iterations; i++)
+    {
+        y = y * (1.5 - 0.5 * u * y * y);
+    }
+    return y;
+}
+
+/*  The fewest Newton steps that bring the relative error under tolerance, within max_depth levels  */
+inline Inverse_Sqrt_Plan plan_inverse_sqrt(double U_min, double U_max, double tolerance, size_t max_depth)
+{
+    if (!(U_min > 0 && U_max > U_min))
+    {
+        throw invalid_argument("plan_inverse_sqrt: need 0 < U_min < U_max");
+    }
+
+    Inverse_Sqrt_Plan plan;
+    plan.U_min = U_min;
+    plan.U_max = U_max;
+
+    /*  min sum (sqrt(u) (a + b u) - 1)^2 over a grid - the 2x2 normal equations  */
+    const size_t grid = 4096;
+    double u_low = U_min / U_max;
+    double s11 = 0, s12 = 0, s22 = 0, r1 = 0, r2 = 0;
+    for (size_t i = 0; i <= grid; i++)
+    {
+        double u = u_low + (1.0 - u_low) * i / grid;
+        double f0 = sqrt(u), f1 = u * sqrt(u);
+        s11 += f0 * f0;
+        s12 += f0 * f1;
+        s22 += f1 * f1;
+        r1 += f0;
+        r2 += f1;
+    }
+    double det = s11 * s22 - s12 * s12;
+    plan.a = (r1 * s22 - r2 * s12) / det;
+    plan.b = (s11 * r2 - s12 * r1) / det;
+
+    for (size_t i = 0; i <= grid; i++)
+    {
+        double u = u_low + (1.0 - u_low) * i / grid;
+        double y0 = plan.a + plan.b * u;
+        if (y0 <= 0 || u * y0 * y0 >= 3)
+        {
+            throw invalid_argument("plan_inverse_sqrt: range too wide for the Newton iteration to converge");
+        }
+    }
+
+    for (plan.iterations = 0; ; plan.iterations++)
+    {
+        plan.depth = 2 + 2 * plan.iterations;
+        if (plan.depth > max_depth)
+        {
+            throw invalid_argument("plan_inverse_sqrt: tolerance not reachable within the modulus chain");
+        }
+        plan.max_rel_error = 0;
+        for (size_t i = 0; i <= grid; i++)
+        {
+            double u = u_low + (1.0 - u_low) * i / grid;
+            double y = approximate_inverse_sqrt(u, plan.a, plan.b, plan.iterations);
+            plan.max_rel_error = max(plan.max_rel_error, std::abs(y * sqrt(u) - 1));
+        }
+        if (plan.max_rel_error <= tolerance)
+        {
+            break;
+        }
+    }
+
+    print_line(__LINE__);
+    cout << "Inverse square root on [" << U_min << ", " << U_max << "]: y0 = " << plan.a << " + " << plan.b
+         << " u, " << plan.iterations << " Newton steps, depth " << plan.depth << ", max relative error "
+         << plan.max_rel_error << endl;
+    return plan;
+}
+
+/*  Inputs "D" and "U" (the aggregated sums), output "Z". Works slot-wise, so a batch of studies packed
+ *  into the slots gets all its Z values from one evaluation.  */
+inline Circuit build_z_circuit(const Inverse_Sqrt_Plan& plan)
+{
+    Circuit circuit;
+    int D = circuit.input("D");
+    int U = circuit.input("U");
+
+    int y = circuit.add_const(circuit.multiply_const(U, plan.b / plan.U_max), plan.a);
+    int minus_half_u = circuit.multiply_const(U, -0.5 / plan.U_max);
+    for (size_t i = 0; i < plan.iterations; i++)
+    {
+        int y_cube_term = circuit.multiply(circuit.multiply(minus_half_u, y), circuit.square(y));
+        y = circuit.add(y_cube_term, circuit.multiply_const(y, 1.5));
+    }
+
+    int D_normalized = circuit.multiply_const(D, 1 / sqrt(plan.U_max));
+    circuit.output("Z", circuit.multiply(D_normalized, y));
+    return circuit;
+}
+
+#endif // SEAL_INVERSE_SQRT_H
@@ -0,0 +1,97 @@
+//
+// K-sample logrank: slot layout of the packed client message and the chi-square statistic.
+//
+
+#ifndef SEAL_K_SAMPLE_H
+#define SEAL_K_SAMPLE_H
+
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+/*  A K-sample message packs (K-1) O-E terms followed by the (K-1)x(K-1) covariance matrix (row-major)
+ *  into the slots of a single ciphertext:
+ *      [ U_0 .. U_{K-2} | V_00 V_01 .. V_{K-2,K-2} ]
+ *  For poly_modulus_degree = 8192 there are 4096 slots, which holds K <= 64 (63 + 63*63 = 4032). */
+inline size_t k_sample_slot_count(int K)
+{
+    size_t dim = K - 1;
+    return dim + dim * dim;
+}
+
+inline std::vector<double> pack_k_sample_msg(const std::vector<double>& U, const std::vector<double>& V,
+                                             size_t slot_count)
+{
+    if (V.size() != U.size() * U.size())
+    {
+        throw std::invalid_argument("pack_k_sample_msg: V must be a (K-1)x(K-1) matrix");
+    }
+    if (U.size() + V.size() > slot_count)
+    {
+        throw std::invalid_argument("pack_k_sample_msg: too many groups for a single ciphertext");
+    }
+
+    std::vector<double> packed(U);
+    packed.insert(packed.end(), V.begin(), V.end());
+    return packed;
+}
+
+/*  chi^2 = U^T V^-1 U with K-1 degrees of freedom.
+ *  V is symmetric positive definite, solved by Gaussian elimination with partial pivoting. */
+inline double k_sample_chi_square(const std::vector<double>& packed, int K)
+{
+    size_t dim = K - 1;
+    std::vector<double> U(packed.begin(), packed.begin() + dim);
+    std::vector<double> A(packed.begin() + dim, packed.begin() + dim + dim * dim);
+    std::vector<double> x(U);
+
+    for (size_t col = 0; col < dim; col++)
+    {
+        size_t pivot = col;
+        for (size_t row = col + 1; row < dim; row++)
+        {
+            if (std::abs(A[row * dim + col]) > std::abs(A[pivot * dim + col]))
+            {
+                pivot = row;
+            }
+        }
+        if (A[pivot * dim + col] == 0)
+        {
+            throw std::runtime_error("k_sample_chi_square: singular covariance matrix");
+        }
+        if (pivot != col)
+        {
+            for (size_t k = 0; k < dim; k++)
+            {
+                std::swap(A[col * dim + k], A[pivot * dim + k]);
+            }
+            std::swap(x[col], x[pivot]);
+        }
+        for (size_t row = col + 1; row < dim; row++)
+        {
+            double factor = A[row * dim + col] / A[col * dim + col];
+            for (size_t k = col; k < dim; k++)
+            {
+                A[row * dim + k] -= factor * A[col * dim + k];
+            }
+            x[row] -= factor * x[col];
+        }
+    }
+    for (size_t row = dim; row-- > 0;)
+    {
+        for (size_t k = row + 1; k < dim; k++)
+        {
+            x[row] -= A[row * dim + k] * x[k];
+        }
+        x[row] /= A[row * dim + row];
+    }
+
+    double chi_square = 0;
+    for (size_t k = 0; k < dim; k++)
+    {
+        chi_square += U[k] * x[k];
+    }
+    return chi_square;
+}
+
+#endif // SEAL_K_SAMPLE_H
@@ -0,0 +1,166 @@
+//
+// K-sample logrank simulation and throughput benchmark against K-1 pairwise protocols.
+//
+
+#include <exception>
+#include <queue>
+#include "../../../examples.h"
+#include "client.h"
+#include "creator_server.h"
+#include "evaluator_server.h"
+#include "k_sample.h"
+#include "logrank_simulation.h"
+#include "survival_data_loader.h"
+#include "serv_func.h"
+using namespace std;
+using namespace seal;
+
+/*  Exponential survival with a different hazard per arm, uniform censoring, times rounded to days  */
+Survival_Columns sample_k_arm_cohort(size_t num_of_records, int K, unsigned int seed)
+{
+    mt19937_64 gen(seed);
+    exponential_distribution<double> base_hazard(1.0 / 365);
+    uniform_real_distribution<double> censoring(0, 5 * 365);
+    uniform_int_distribution<int> arm(0, K - 1);
+
+    Survival_Columns columns;
+    columns.reserve(num_of_records);
+    for (size_t i = 0; i < num_of_records; i++)
+    {
+        int group = arm(gen);
+        double t = base_hazard(gen) * (1.0 + 0.1 * group);
+        double c = censoring(gen);
+        columns.push_back(floor(min(t, c)) + 1, (uint8_t)(t <= c), (uint8_t)group);
+    }
+    return columns;
+}
+
+/*  Two-group view of the cohort: arm 0 against arm k (relabelled as group 1)  */
+Survival_Columns select_arms(const Survival_Columns& columns, int k)
+{
+    Survival_Columns pair;
+    for (size_t i = 0; i < columns.size(); i++)
+    {
+        if (columns.group[i] == 0 || columns.group[i] == k)
+        {
+            pair.push_back(columns.time[i], columns.event[i], (uint8_t)(columns.group[i] == k));
+        }
+    }
+    return pair;
+}
+
+void Logrank_k_sample_sim(int num_of_clients, int K, size_t records_per_client)
+{
+    cout << " ---------------------------------" << endl;
+    cout << " ---START K-SAMPLE SIMULATION K=" << K << "---" << endl;
+    cout << " ---------------------------------" << endl;
+
+    std::queue<Cipher_Msg> enc_msg_q;
+    std::queue<Decrypted_Result> decrypted_result_q;
+
+    const int scale_cost_param = 30;
+    double scale = pow(2.0, scale_cost_param);
+
+    std::shared_ptr<SEALContext> context = create_context(scale_cost_param);
+    std::shared_ptr<CKKSEncoder> encoder = create_encoder(context);
+
+    creator_server key_server(context, encoder, &decrypted_result_q);
+    evaluator_server eval_server(context, key_server.get_relin_keys(), &enc_msg_q, scale);
+
+    vector<Survival_Columns> cohorts;
+    vector<vector<double>> U(num_of_clients), V(num_of_clients);
+    for (int i = 0; i < num_of_clients; i++)
+    {
+        cohorts.push_back(sample_k_arm_cohort(records_per_client, K, 3000 + i));
+        compute_k_sample_statistics(cohorts[i], K, U[i], V[i]);
+    }
+
+    /*  Calculate the protocol correct output, for verification only  */
+    vector<double> sigma(k_sample_slot_count(K), 0.0);
+    for (int i = 0; i < num_of_clients; i++)
+    {
+        vector<double> packed = pack_k_sample_msg(U[i], V[i], encoder->slot_count());
+        for (size_t s = 0; s < sigma.size(); s++)
+        {
+            sigma[s] += packed[s];
+        }
+    }
+    double trueResult = k_sample_chi_square(sigma, K);
+    cout << " True value: " << trueResult << endl;
+
+    vector<client*> clients(num_of_clients);
+    for (int i = 0; i < num_of_clients; i++)
+    {
+        clients[i] = new client(context, encoder, key_server.get_public_key(), &enc_msg_q, &decrypted_result_q, scale,
+                                0, 0, 0, 1.0);
+    }
+
+    /*  K-sample protocol: one ciphertext per client  */
+    chrono::high_resolution_clock::time_point time_start = chrono::high_resolution_clock::now();
+    for (int i = 0; i < num_of_clients; i++)
+    {
+        clients[i]->get_encryped_k_sample_msg(U[i], V[i]);
+    }
+    Encrypted_Result encryptedResult = eval_server.evaluate_packed();
+    key_server.decrypt_packed_msg(encryptedResult, k_sample_slot_count(K));
+    double calculatedResult = clients[0]->get_k_sample_result(K);
+    chrono::microseconds k_sample_time =
+        chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - time_start);
+
+    cout << "The calculated chi-square is : " << calculatedResult << " (" << K - 1 << " degrees of freedom)" << endl;
+    if (std::abs((calculatedResult - trueResult) / calculatedResult) > 0.001)
+    {
+        cout << "---- ERROR!! ----- the gap is : " << std::abs((calculatedResult - trueResult) / calculatedResult) << endl;
+        throw;
+    }
+
+    /*  Baseline: K-1 pairwise two-group protocols (arm 0 against arm k), two ciphertexts per client each  */
+    vector<Site_Statistics> pair_stats(num_of_clients);
+    chrono::microseconds pairwise_time(0);
+    for (int k = 1; k < K; k++)
+    {
+        for (int i = 0; i < num_of_clients; i++)
+        {
+            pair_stats[i] = compute_site_statistics(select_arms(cohorts[i], k));
+        }
+
+        vector<client*> pair_clients(num_of_clients);
+        for (int i = 0; i < num_of_clients; i++)
+        {
+            pair_clients[i] = new client(context, encoder, key_server.get_public_key(), &enc_msg_q, &decrypted_result_q,
+                                         scale, pair_stats[i].O, pair_stats[i].E, pair_stats[i].V, 1.0);
+        }
+
+        time_start = chrono::high_resolution_clock::now();
+        for (int i = 0; i < num_of_clients; i++)
+        {
+            pair_clients[i]->get_encryped_msg();
+        }
+        key_server.decrypt_msg(eval_server.evaluate());
+        pairwise_time += chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - time_start);
+
+        for (int i = 0; i < num_of_clients; i++)
+        {
+            delete pair_clients[i];
+        }
+    }
+
+    cout << "K-sample protocol: " << k_sample_time.count() / 1000 << " ms, "
+         << num_of_clients * 1e6 / max(1.0, (double)k_sample_time.count()) << " clients/sec" << endl;
+    cout << K - 1 << " pairwise protocols: " << pairwise_time.count() / 1000 << " ms, "
+         << num_of_clients * 1e6 / max(1.0, (double)pairwise_time.count()) << " clients/sec" << endl;
+
+    for (int i = 0; i < num_of_clients; i++)
+    {
+        delete clients[i];
+    }
+}
+
+void example_k_sample_logrank_test()
+{
+    int groups[] = {3, 4, 8, 64};
+    for (int K : groups)
+    {
+        Logrank_k_sample_sim(5, K, 10000);
+    }
+}
@@ -0,0 +1,73 @@
+//
+// Federated Kaplan-Meier curves: per-bin counts of the site and the pooled curve.
+//
+
+#ifndef SEAL_KAPLAN_MEIER_H
+#define SEAL_KAPLAN_MEIER_H
+
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+#include "survival_data_loader.h"
+
+/*  Time is cut into num_of_bins bins of bin_width: bin b = [b * bin_width, (b+1) * bin_width).
+ *  events[b]  - the site's events in bin b
+ *  at_risk[b] - the site's patients still under observation at the start of bin b (time >= b * bin_width)
+ *  Both are additive over sites, so the evaluator only sums them. Times past the last bin are cut off.  */
+inline void compute_km_bin_counts(const Survival_Columns& columns, double bin_width, size_t num_of_bins,
+                                  std::vector<double>& events, std::vector<double>& at_risk)
+{
+    events.assign(num_of_bins, 0.0);
+    std::vector<double> leaving(num_of_bins, 0.0);
+    double still_at_risk = 0;
+    for (size_t i = 0; i < columns.size(); i++)
+    {
+        size_t bin = (size_t)(columns.time[i] / bin_width);
+        if (bin >= num_of_bins)
+        {
+            still_at_risk += 1;
+            continue;
+        }
+        events[bin] += columns.event[i];
+        leaving[bin] += 1;
+    }
+
+    /*  at_risk[b] = rows leaving in bins >= b, plus those beyond the last bin  */
+    at_risk.assign(num_of_bins, 0.0);
+    for (size_t b = num_of_bins; b-- > 0;)
+    {
+        still_at_risk += leaving[b];
+        at_risk[b] = still_at_risk;
+    }
+}
+
+/*  A curve longer than the slots of one ciphertext is sent as consecutive chunks of slot_count bins  */
+inline size_t km_chunk_count(size_t num_of_bins, size_t slot_count)
+{
+    return (num_of_bins + slot_count - 1) / slot_count;
+}
+
+/*  hazard[b] = d_b / n_b, survival[b] = prod_{c <= b} (1 - hazard[c]) at the end of bin b.
+ *  The pooled counts come out of CKKS with small errors, so they are rounded to the integers they are,
+ *  and an empty risk set gives hazard 0 (the curve stays flat).  */
+inline void kaplan_meier_curve(const std::vector<double>& events, const std::vector<double>& at_risk,
+                               std::vector<double>& hazard, std::vector<double>& survival)
+{
+    if (events.size() != at_risk.size())
+    {
+        throw std::invalid_argument("kaplan_meier_curve: events and at_risk differ in length");
+    }
+    hazard.assign(events.size(), 0.0);
+    survival.assign(events.size(), 0.0);
+    double s = 1.0;
+    for (size_t b = 0; b < events.size(); b++)
+    {
+        double d = std::round(events[b]);
+        double n = std::round(at_risk[b]);
+        hazard[b] = (n > 0) ? d / n : 0.0;
+        s *= 1.0 - hazard[b];
+        survival[b] = s;
+    }
+}
+
+#endif // SEAL_KAPLAN_MEIER_H
@@ -0,0 +1,319 @@
+//
+// Record-and-replay load generator: recorded client uploads replayed into the evaluator at a set rate.
+//
+
+#ifndef SEAL_LOAD_GENERATOR_H
+#define SEAL_LOAD_GENERATOR_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <thread>
+#include "../../../examples.h"
+#include "evaluator_server.h"
+#include "metrics.h"
+#include "serv_func.h"
+#include "simulation_config.h"
+#include "spool.h"
+
+enum Arrival_Schedule
+{
+    ARRIVAL_CONSTANT = 0,    // one upload every 1/rate seconds
+    ARRIVAL_POISSON = 1      // exponential gaps of mean 1/rate (independent clients)
+};
+
+struct Replay_Config
+{
+    string recording_dir = "logrank_recording";
+    size_t num_of_recorded = 100;    // uploads recorded once, then replayed round robin
+    double rate = 100;               // offered load, uploads per second
+    Arrival_Schedule schedule = ARRIVAL_POISSON;
+    size_t concurrency = 4;          // sender threads
+    double duration_s = 60;
+    double report_interval_s = 10;
+    uint64_t seed = 1;
+    string csv_path;
+};
+
+inline void set_replay_option(Replay_Config& config, const string& key, const string& value)
+{
+    if (key == "recording")
+    {
+        config.recording_dir = value;
+    }
+    else if (key == "recorded")
+    {
+        config.num_of_recorded = max(1ul, stoul(value));
+    }
+    else if (key == "rate")
+    {
+        config.rate = stod(value);
+    }
+    else if (key == "schedule")
+    {
+        if (value != "constant" && value != "poisson")
+        {
+            throw invalid_argument("schedule must be constant or poisson, got " + value);
+        }
+        config.schedule = (value == "constant") ? ARRIVAL_CONSTANT : ARRIVAL_POISSON;
+    }
+    else if (key == "concurrency")
+    {
+        config.concurrency = max(1ul, stoul(value));
+    }
+    else if (key == "duration")
+    {
+        config.duration_s = stod(value);
+    }
+    else if (key == "report_interval")
+    {
+        config.report_interval_s = stod(value);
+    }
+    else if (key == "seed")
+    {
+        config.seed = stoull(value);
+    }
+    else if (key == "csv")
+    {
+        config.csv_path = value;
+    }
+    else
+    {
+        throw invalid_argument("unknown replay option: " + key);
+    }
+    if (config.rate <= 0 || config.report_interval_s <= 0)
+    {
+        throw invalid_argument("rate and report_interval must be positive");
+    }
+}
+
+/*  One line of the report: totals since the start, rates and latencies over the last interval  */
+struct Replay_Report
+{
+    double elapsed_s = 0;
+    size_t sent = 0;
+    size_t merged = 0;
+    double merged_per_sec = 0;
+    double p50_ms = 0;
+    double p99_ms = 0;
+    double p999_ms = 0;
+    double max_ms = 0;
+    double max_send_lag_ms = 0;    // how far behind the schedule a sender started an upload
+    size_t backlog = 0;            // uploads sent but not merged yet
+};
+
+/*  The arrival times are fixed in advance (open loop): the n-th upload is due at its time whether or not
+ *  the evaluator kept up, so an overloaded evaluator shows up as a growing backlog and latency instead of
+ *  as a lower offered load. Shared by the senders; next() hands out the uploads in order.  */
+class arrival_clock
+{
+private:
+    std::mutex mutex;
+    mt19937_64 gen;
+    exponential_distribution<double> gap;
+    Arrival_Schedule schedule;
+    double rate;
+    double duration_s;
+    double next_due_s = 0;
+    size_t next_seq = 0;
+
+public:
+    arrival_clock(const Replay_Config& config)
+        : gen(config.seed), gap(config.rate), schedule(config.schedule), rate(config.rate),
+          duration_s(config.duration_s) {}
+
+    /*  false once the next arrival would fall after the end of the run  */
+    bool next(size_t& seq, double& due_s)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        next_due_s += (schedule == ARRIVAL_POISSON) ? gap(gen) : 1.0 / rate;
+        if (next_due_s > duration_s)
+        {
+            return false;
+        }
+        seq = next_seq++;
+        due_s = next_due_s;
+        return true;
+    }
+};
+
+/*  Replays the recorded uploads into the evaluator's input path (enc_msg_q + merge_deltas).
+ *
+ *  The recording is read into memory once, in the spool format. Each arrival deserializes its upload again,
+ *  as the evaluator would from the wire, so nothing is re-encrypted. Replayed upload n carries the client_id
+ *  of recording n % size, so the set of contributors stays bounded over hours-long runs. The evaluator merges
+ *  them with merge_deltas: merge_arrivals would drop every replay of a client that already contributed.
+ *
+ *  The senders put the uploads in an inbox with their due time. The calling thread is the evaluator: it
+ *  moves the inbox to enc_msg_q, merges, and records due time -> merged for every upload. Latency counts
+ *  from the due time, not the send time, so a sender that fell behind does not hide the delay.  */
+class replay_load_generator
+{
+private:
+    std::shared_ptr<SEALContext> context;
+    evaluator_server& eval_server;
+    std::queue<Cipher_Msg>& enc_msg_q;
+    Replay_Config config;
+    vector<vector<SEAL_BYTE>> recording;
+
+    typedef chrono::steady_clock::time_point Time_Point;
+    std::mutex inbox_mutex;
+    std::condition_variable inbox_ready;
+    std::queue<pair<Cipher_Msg, Time_Point>> inbox;
+
+    std::atomic<size_t> sent{0};
+    std::atomic<size_t> senders_running{0};
+    std::atomic<uint64_t> max_send_lag_ns{0};
+
+    void send_loop(arrival_clock& clock, Time_Point start)
+    {
+        size_t seq;
+        double due_s;
+        while (clock.next(seq, due_s))
+        {
+            Time_Point due = start + chrono::duration_cast<chrono::steady_clock::duration>(
+                                         chrono::duration<double>(due_s));
+            std::this_thread::sleep_until(due);
+
+            uint64_t lag = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - due).count();
+            uint64_t seen = max_send_lag_ns.load(std::memory_order_relaxed);
+            while (lag > seen && !max_send_lag_ns.compare_exchange_weak(seen, lag, std::memory_order_relaxed))
+            {
+            }
+
+            const vector<SEAL_BYTE>& record = recording[seq % recording.size()];
+            Cipher_Msg msg;
+            load_spool_record(context, record.data(), record.size(), msg);
+            msg.client_id = (int)(seq % recording.size());
+            {
+                std::lock_guard<std::mutex> lock(inbox_mutex);
+                inbox.emplace(std::move(msg), due);
+                sent++;
+            }
+            inbox_ready.notify_one();
+        }
+        {
+            std::lock_guard<std::mutex> lock(inbox_mutex);
+            senders_running--;
+        }
+        inbox_ready.notify_one();
+    }
+
+public:
+    replay_load_generator(std::shared_ptr<SEALContext> context_, evaluator_server& eval_server_,
+                          std::queue<Cipher_Msg>& enc_msg_q_, const Replay_Config& config_)
+        : context(context_), eval_server(eval_server_), enc_msg_q(enc_msg_q_), config(config_)
+    {
+        for (const string& path : list_spool(config.recording_dir))
+        {
+            recording.push_back(read_spool_file(path));
+        }
+        if (recording.empty())
+        {
+            throw invalid_argument("replay_load_generator: no recorded uploads in " + config.recording_dir);
+        }
+    }
+
+    size_t get_recording_size() const
+    {
+        return recording.size();
+    }
+
+    /*  Runs for config.duration_s and calls report every config.report_interval_s, then once more after the
+     *  backlog is merged. The latencies also go to the "replay_latency" histogram of the metrics registry.  */
+    void run(const function<void(const Replay_Report&)>& report)
+    {
+        Metrics_Histogram& total_latency = Metrics_Registry::global().histogram("replay_latency");
+        std::unique_ptr<Metrics_Histogram> interval_latency(new Metrics_Histogram());
+
+        arrival_clock clock(config);
+        Time_Point start = chrono::steady_clock::now();
+        senders_running = max((size_t)1, config.concurrency);
+        vector<thread> senders;
+        for (size_t t = 0; t < max((size_t)1, config.concurrency); t++)
+        {
+            senders.emplace_back(&replay_load_generator::send_loop, this, std::ref(clock), start);
+        }
+
+        chrono::duration<double> report_interval(config.report_interval_s);
+        Time_Point next_report = start + chrono::duration_cast<chrono::steady_clock::duration>(report_interval);
+        Time_Point last_report = start;
+        size_t merged = 0, merged_at_last_report = 0;
+
+        auto emit_report = [&](Time_Point now) {
+            Replay_Report line;
+            line.elapsed_s = chrono::duration<double>(now - start).count();
+            line.sent = sent;
+            line.merged = merged;
+            line.merged_per_sec = (merged - merged_at_last_report) /
+                                  max(1e-9, chrono::duration<double>(now - last_report).count());
+            line.p50_ms = interval_latency->percentile(0.5) / 1e6;
+            line.p99_ms = interval_latency->percentile(0.99) / 1e6;
+            line.p999_ms = interval_latency->percentile(0.999) / 1e6;
+            line.max_ms = interval_latency->get_max() / 1e6;
+            line.max_send_lag_ms = max_send_lag_ns.exchange(0) / 1e6;
+            line.backlog = line.sent - merged;
+            report(line);
+
+            interval_latency.reset(new Metrics_Histogram());
+            merged_at_last_report = merged;
+            last_report = now;
+        };
+
+        vector<Time_Point> due_times;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(inbox_mutex);
+                inbox_ready.wait_until(lock, next_report,
+                                       [&]() { return !inbox.empty() || senders_running == 0; });
+                if (inbox.empty() && senders_running == 0)
+                {
+                    break;
+                }
+                due_times.clear();
+                while (!inbox.empty())
+                {
+                    enc_msg_q.push(std::move(inbox.front().first));
+                    due_times.push_back(inbox.front().second);
+                    inbox.pop();
+                }
+            }
+
+            merged += eval_server.merge_deltas();
+            Time_Point now = chrono::steady_clock::now();
+            for (const Time_Point& due : due_times)
+            {
+                uint64_t latency = chrono::duration_cast<chrono::nanoseconds>(now - due).count();
+                interval_latency->record(latency);
+                total_latency.record(latency);
+            }
+
+            if (now >= next_report)
+            {
+                emit_report(now);
+                while (next_report <= now)
+                {
+                    next_report += chrono::duration_cast<chrono::steady_clock::duration>(report_interval);
+                }
+            }
+        }
+
+        for (thread& sender : senders)
+        {
+            sender.join();
+        }
+        emit_report(chrono::steady_clock::now());
+    }
+};
+
+/*  The driver (replay_simulation.cpp):
+ *      logrank --recording=uploads --rate=500 --schedule=poisson --concurrency=8 --duration=10800 --csv=soak.csv  */
+int run_replay_load(int argc, char* argv[]);
+
+#endif // SEAL_LOAD_GENERATOR_H
@@ -42,8 +42,8 @@ void Logrank_protocol_sim (int num_of_clients) {
     std::shared_ptr<CKKSEncoder> encoder = create_encoder(context);
 
     /*  Init values - sample random numbers to be clients' inputs   */
-    ClientsInput inputs[num_of_clients];
-    sample_inputs_clients(inputs, num_of_clients);
+    vector<ClientsInput> inputs(num_of_clients);
+    sample_inputs_clients(inputs.data(), num_of_clients);
 
     /*  Calculate the protocol correct output, for verification only  */
     double sigma_O = 0, sigma_E = 0, sigma_V = 0;
@@ -70,7 +70,7 @@ void Logrank_protocol_sim (int num_of_clients) {
 
     /*  client entities: perform the experiment and wait for the decrypted output.
      *  In this simulation the experiment results are given to the object */
-    client* clients[num_of_clients];
+    vector<client*> clients(num_of_clients);
     for (int i=0; i<num_of_clients; i++)
     {
         clients[i] = new client(context, encoder, key_server.get_public_key(), &enc_msg_q, &decrypted_result_q, scale,
@@ -104,6 +104,7 @@ void Logrank_protocol_sim (int num_of_clients) {
 
     /*  6. Measure performance of the online phase */
     measure_test_time(time_start);
+    print_peak_memory();
 
     /* delete */
     for (int i=0; i<num_of_clients; i++)
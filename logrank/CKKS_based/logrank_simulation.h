@@ -5,10 +5,34 @@
 #ifndef SEAL_LOGRANK_SIMULATION_H
 #define SEAL_LOGRANK_SIMULATION_H
 
+#include <cstdio>
 #include <random>
+#include <sys/resource.h>
+#include <unistd.h>
 using namespace std;
 
 void example_logrank_5_clients_test();
+void example_cohort_data_test();
+void example_weighted_logrank_test();
+void example_k_sample_logrank_test();
+void example_hierarchical_logrank_test();
+void example_deadline_logrank_test();
+void example_incremental_logrank_test();
+void example_interim_monitoring_test();
+void example_checkpoint_logrank_test();
+void example_spool_logrank_test();
+void example_bfv_logrank_test();
+void example_encrypted_z_test();
+void example_permutation_logrank_test();
+void example_kaplan_meier_test();
+void example_bgw_multiplication_test();
+void example_bgw_packed_sharing_test();
+void example_bgw_fixed_point_test();
+void example_scalable_logrank_test();
+void example_parameter_sweep_test();
+void example_replay_load_test();
+void example_engine_benchmark_test();
+void example_key_setup_test();
 
 struct Inputs3Clients
 {
@@ -43,6 +67,35 @@ struct Crypto_Resources
     CKKSEncoder encoder;
 };
 
+/*  CKKS_ENGINE - approximate fixed-scale arithmetic (the original protocol).
+ *  BFV_ENGINE  - exact batched integer arithmetic on fixed-point inputs (see bfv_engine.h).  */
+enum Engine_Type
+{
+    CKKS_ENGINE,
+    BFV_ENGINE
+};
+
+inline std::__1::shared_ptr<seal::SEALContext> create_bfv_context(const int plain_modulus_bits)
+{
+    /*  BFV does not consume levels on additions, so the default coefficient modulus for 8192 (218 bits) is
+     *  only there for the noise budget. The plain modulus must be a prime = 1 mod 2*8192 to allow batching,
+     *  and wide enough that the sum of every client's fixed-point input never wraps around
+     *  (see bfv_plain_modulus_bits).  */
+    EncryptionParameters parms(scheme_type::BFV);
+    size_t poly_modulus_degree = 8192;
+    parms.set_poly_modulus_degree(poly_modulus_degree);
+    parms.set_coeff_modulus(CoeffModulus::BFVDefault(poly_modulus_degree));
+    parms.set_plain_modulus(PlainModulus::Batching(poly_modulus_degree, plain_modulus_bits));
+
+    auto context = SEALContext::Create(parms);
+
+    print_parameters(context);
+    cout << endl;
+    cout << "Parameter validation (success): " << context->parameter_error_message() << endl;
+
+    return context;
+}
+
 inline std::__1::shared_ptr<seal::SEALContext> create_context(const int scale_cost_param)
 {
     /* I increased the bit_sizes from (60, 40, 40, 60) to (60, 30, 30, 30, 60) to avoid wrap around bugs
@@ -73,6 +126,69 @@ inline std::__1::shared_ptr<seal::SEALContext> create_context(const int scale_co
     return context;
 }
 
+/*  A chain with `depth` levels of scale_cost_param bits, for circuits deeper than the protocol's
+ *  (e.g. Z under encryption). 16384 allows up to 438 bits of coefficient modulus.  */
+inline std::__1::shared_ptr<seal::SEALContext> create_deep_context(const int scale_cost_param, const size_t depth)
+{
+    size_t poly_modulus_degree = 16384;
+    vector<int> bit_sizes(depth + 2, scale_cost_param);
+    bit_sizes.front() = 60;
+    bit_sizes.back() = 60;
+    if (120 + (int)depth * scale_cost_param > CoeffModulus::MaxBitCount(poly_modulus_degree))
+    {
+        throw invalid_argument("create_deep_context: " + to_string(depth) + " levels of " +
+                               to_string(scale_cost_param) + " bits do not fit in poly_modulus_degree 16384");
+    }
+
+    EncryptionParameters parms(scheme_type::CKKS);
+    parms.set_poly_modulus_degree(poly_modulus_degree);
+    parms.set_coeff_modulus(CoeffModulus::Create(poly_modulus_degree, bit_sizes));
+
+    auto context = SEALContext::Create(parms);
+
+    print_parameters(context);
+    cout << endl;
+    cout << "Parameter validation (success): " << context->parameter_error_message() << endl;
+
+    return context;
+}
+
+/*  The chain of create_context (60, 3 x scale_cost_param, 60) at another poly_modulus_degree, for the
+ *  parameter sweep  */
+inline std::__1::shared_ptr<seal::SEALContext> create_sized_context(const size_t poly_modulus_degree,
+                                                                    const int scale_cost_param)
+{
+    if (120 + 3 * scale_cost_param > CoeffModulus::MaxBitCount(poly_modulus_degree))
+    {
+        throw invalid_argument("create_sized_context: 3 levels of " + to_string(scale_cost_param) +
+                               " bits do not fit in poly_modulus_degree " + to_string(poly_modulus_degree));
+    }
+
+    EncryptionParameters parms(scheme_type::CKKS);
+    parms.set_poly_modulus_degree(poly_modulus_degree);
+    parms.set_coeff_modulus(CoeffModulus::Create(poly_modulus_degree,
+                                                 { 60, scale_cost_param, scale_cost_param, scale_cost_param, 60 }));
+
+    auto context = SEALContext::Create(parms);
+
+    print_parameters(context);
+    cout << endl;
+    cout << "Parameter validation: " << context->parameter_error_message() << endl;
+
+    return context;
+}
+
+/*  For BFV_ENGINE scale_cost_param is ignored and plain_modulus_bits sizes the plaintext modulus  */
+inline std::__1::shared_ptr<seal::SEALContext> create_context(const int scale_cost_param, Engine_Type engine,
+                                                              const int plain_modulus_bits)
+{
+    if (engine == BFV_ENGINE)
+    {
+        return create_bfv_context(plain_modulus_bits);
+    }
+    return create_context(scale_cost_param);
+}
+
 inline std::__1::shared_ptr<seal::CKKSEncoder> create_encoder(std::__1::shared_ptr<seal::SEALContext> context)
 {
     auto encoder = std::make_shared<CKKSEncoder>(context); // the encoder use poly_modulus_degree/2 slots => 4096
@@ -91,6 +207,21 @@ inline void sample_inputs_clients(ClientsInput* inputs, int number_of_clients)
         inputs[i].r = (double) (rand() % 4096);
     }
 }
+/*  The same distribution as sample_inputs_clients, from a stream of its own per client: the inputs depend
+ *  only on (seed, client_id), not on which thread draws them or in which order.  */
+inline ClientsInput sample_client_input(uint64_t seed, uint64_t client_id)
+{
+    std::seed_seq seq{(uint32_t)seed, (uint32_t)(seed >> 32), (uint32_t)client_id, (uint32_t)(client_id >> 32)};
+    mt19937_64 gen(seq);
+
+    ClientsInput input;
+    input.O = gen() % 4096;
+    input.E = (double) (gen() % 4096000)/1000;
+    input.V = (double) (gen() % 4096000)/1000;
+    input.r = (double) (gen() % 4096);
+    return input;
+}
+
 inline Inputs3Clients sample_inputs_3_clients()
 {
     //sample random values.
@@ -114,18 +245,34 @@ inline Inputs3Clients sample_inputs_3_clients()
     return inputs;
 }
 
-inline void verify_result(client* client, double trueResult)
+inline void verify_result(client* client, double trueResult, double tolerance = 0.001)
 {
     /*  Simulation verification  */
     double calculatedResult = client->get_result();
     cout << "True result : " << trueResult << endl;
-    if(std::abs ((double)(calculatedResult - trueResult)/calculatedResult) > 0.001)
+    if(std::abs ((double)(calculatedResult - trueResult)/calculatedResult) > tolerance)
     {
         cout << "---- ERROR!! ----- the gap is : " << std::abs((double)(calculatedResult - trueResult)/calculatedResult) << endl;
         throw;
     }
 }
 
+inline void verify_weighted_results(client* client, const vector<double>& trueResults)
+{
+    /*  Simulation verification, one Z per weight function  */
+    vector<double> calculatedResults = client->get_weighted_results();
+    for (size_t i = 0; i < trueResults.size(); i++)
+    {
+        double gap = std::abs((double)(calculatedResults[i] - trueResults[i]) / calculatedResults[i]);
+        cout << "Weight " << i << ": calculated Z : " << calculatedResults[i] << " True result : " << trueResults[i] << endl;
+        if (gap > 0.001)
+        {
+            cout << "---- ERROR!! ----- the gap is : " << gap << endl;
+            throw;
+        }
+    }
+}
+
 inline void measure_test_time(chrono::high_resolution_clock::time_point time_start)
 {
     /*  Measure performance of the online phase */
@@ -134,5 +281,40 @@ inline void measure_test_time(chrono::high_resolution_clock::time_point time_sta
     cout << "END ONLINE PHASE [" << time_diff.count() << " milliseconds]" << endl;
 
 }
+
+inline long peak_memory_kb()
+{
+    /*  ru_maxrss is reported in bytes on macOS and in kilobytes on Linux  */
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+inline long current_memory_kb()
+{
+    /*  Resident set now, from /proc on Linux; elsewhere the peak is the best available bound  */
+    long pages = 0, resident = 0;
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm)
+    {
+        int read = fscanf(statm, "%ld %ld", &pages, &resident);
+        fclose(statm);
+        if (read == 2)
+        {
+            return resident * (sysconf(_SC_PAGESIZE) / 1024);
+        }
+    }
+    return peak_memory_kb();
+}
+
+inline void print_peak_memory()
+{
+    /*  Peak RSS of the whole simulation: the ciphertext copies in the online phase dominate it  */
+    cout << "PEAK MEMORY [" << peak_memory_kb() << " KB]" << endl;
+}
 #endif // SEAL_LOGRANK_SIMULATION_H
 
@@ -0,0 +1,406 @@
+//
+// Runtime metrics: sharded counters, gauges and log-linear latency histograms, exported as Prometheus text or JSON.
+//
+
+#ifndef SEAL_METRICS_H
+#define SEAL_METRICS_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+using namespace std;
+
+const size_t METRICS_SHARDS = 16;
+
+/*  The shard of the calling thread. Threads are numbered on first use and spread round robin, so
+ *  concurrent encryptors or evaluators rarely touch the same cache line.  */
+inline size_t metrics_shard()
+{
+    static std::atomic<size_t> next_thread{0};
+    thread_local size_t shard = next_thread.fetch_add(1, std::memory_order_relaxed) % METRICS_SHARDS;
+    return shard;
+}
+
+/*  A monotonic counter: add() is one relaxed atomic add on the thread's shard, value() sums the shards  */
+class Metrics_Counter
+{
+private:
+    struct alignas(64) Shard
+    {
+        std::atomic<uint64_t> value{0};
+    };
+    Shard shards[METRICS_SHARDS];
+
+public:
+    void add(uint64_t amount = 1)
+    {
+        shards[metrics_shard()].value.fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const
+    {
+        uint64_t total = 0;
+        for (const Shard& shard : shards)
+        {
+            total += shard.value.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+};
+
+/*  The last value set, e.g. the level a result left the evaluator at  */
+class Metrics_Gauge
+{
+private:
+    std::atomic<int64_t> current{0};
+
+public:
+    void set(int64_t value)
+    {
+        current.store(value, std::memory_order_relaxed);
+    }
+
+    int64_t value() const
+    {
+        return current.load(std::memory_order_relaxed);
+    }
+};
+
+/*  HDR-style latency histogram in nanoseconds. Values below 16 have a bucket each; above, every power of
+ *  two is split into 16 linear sub-buckets, so any percentile is known within 1/16 (6.25%) relative,
+ *  over the whole 64-bit range, in 976 buckets. Sharded like Metrics_Counter.  */
+class Metrics_Histogram
+{
+private:
+    static const size_t SUB_BUCKETS = 16;
+    static const size_t BUCKETS = 61 * SUB_BUCKETS;
+
+    struct alignas(64) Shard
+    {
+        std::atomic<uint64_t> counts[BUCKETS];
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> max{0};
+
+        Shard()
+        {
+            for (std::atomic<uint64_t>& bucket : counts)
+            {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+        }
+    };
+    Shard shards[METRICS_SHARDS];
+
+    static size_t bucket_of(uint64_t value)
+    {
+        if (value < SUB_BUCKETS)
+        {
+            return value;
+        }
+        int magnitude = 63 - __builtin_clzll(value);
+        return (magnitude - 3) * SUB_BUCKETS + ((value >> (magnitude - 4)) - SUB_BUCKETS);
+    }
+
+    /*  The middle of the bucket  */
+    static double bucket_value(size_t bucket)
+    {
+        if (bucket < SUB_BUCKETS)
+        {
+            return bucket;
+        }
+        int magnitude = (int)(bucket / SUB_BUCKETS) + 3;
+        double width = ldexp(1.0, magnitude - 4);
+        return (SUB_BUCKETS + bucket % SUB_BUCKETS) * width + width / 2;
+    }
+
+public:
+    void record(uint64_t nanoseconds)
+    {
+        Shard& shard = shards[metrics_shard()];
+        shard.counts[bucket_of(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+        shard.count.fetch_add(1, std::memory_order_relaxed);
+        shard.sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+        uint64_t seen = shard.max.load(std::memory_order_relaxed);
+        while (nanoseconds > seen && !shard.max.compare_exchange_weak(seen, nanoseconds, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    uint64_t get_count() const
+    {
+        uint64_t total = 0;
+        for (const Shard& shard : shards)
+        {
+            total += shard.count.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    uint64_t get_sum() const
+    {
+        uint64_t total = 0;
+        for (const Shard& shard : shards)
+        {
+            total += shard.sum.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    uint64_t get_max() const
+    {
+        uint64_t result = 0;
+        for (const Shard& shard : shards)
+        {
+            result = std::max(result, shard.max.load(std::memory_order_relaxed));
+        }
+        return result;
+    }
+
+    /*  quantile in [0, 1], in nanoseconds  */
+    double percentile(double quantile) const
+    {
+        uint64_t total = get_count();
+        if (total == 0)
+        {
+            return 0;
+        }
+        uint64_t rank = (uint64_t)ceil(quantile * total);
+        uint64_t seen = 0;
+        for (size_t bucket = 0; bucket < BUCKETS; bucket++)
+        {
+            for (const Shard& shard : shards)
+            {
+                seen += shard.counts[bucket].load(std::memory_order_relaxed);
+            }
+            if (seen >= max((uint64_t)1, rank))
+            {
+                return std::min(bucket_value(bucket), (double)get_max());
+            }
+        }
+        return (double)get_max();
+    }
+};
+
+/*  Records the lifetime of the scope into a histogram  */
+class Metrics_Timer
+{
+private:
+    Metrics_Histogram& histogram;
+    chrono::steady_clock::time_point start;
+
+public:
+    explicit Metrics_Timer(Metrics_Histogram& histogram_)
+        : histogram(histogram_), start(chrono::steady_clock::now()) {}
+
+    ~Metrics_Timer()
+    {
+        histogram.record(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+    }
+};
+
+/*  Named counters and histograms. Registration takes a lock once; the returned references stay valid for
+ *  the life of the program, so hot paths keep them (see logrank_metrics) and never look names up.
+ *  Snapshots read the shards without stopping the writers.  */
+class Metrics_Registry
+{
+private:
+    std::mutex mutex;
+    map<string, Metrics_Counter*> counters;
+    map<string, Metrics_Gauge*> gauges;
+    map<string, Metrics_Histogram*> histograms;
+
+    /*  Write to path.tmp and rename, so a scraper never reads a half-written file  */
+    static void write_atomically(const string& path, const string& text)
+    {
+        string tmp_path = path + ".tmp";
+        {
+            ofstream file(tmp_path);
+            file << text;
+        }
+        std::rename(tmp_path.c_str(), path.c_str());
+    }
+
+public:
+    Metrics_Registry() = default;
+    Metrics_Registry(const Metrics_Registry&) = delete;
+    Metrics_Registry& operator=(const Metrics_Registry&) = delete;
+
+    ~Metrics_Registry()
+    {
+        for (auto& entry : counters)
+        {
+            delete entry.second;
+        }
+        for (auto& entry : gauges)
+        {
+            delete entry.second;
+        }
+        for (auto& entry : histograms)
+        {
+            delete entry.second;
+        }
+    }
+
+    static Metrics_Registry& global()
+    {
+        static Metrics_Registry registry;
+        return registry;
+    }
+
+    Metrics_Counter& counter(const string& name)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Metrics_Counter*& counter = counters[name];
+        if (!counter)
+        {
+            counter = new Metrics_Counter();
+        }
+        return *counter;
+    }
+
+    Metrics_Gauge& gauge(const string& name)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Metrics_Gauge*& gauge = gauges[name];
+        if (!gauge)
+        {
+            gauge = new Metrics_Gauge();
+        }
+        return *gauge;
+    }
+
+    Metrics_Histogram& histogram(const string& name)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Metrics_Histogram*& histogram = histograms[name];
+        if (!histogram)
+        {
+            histogram = new Metrics_Histogram();
+        }
+        return *histogram;
+    }
+
+    /*  Counters as logrank_<name>_total, gauges as logrank_<name>, histograms as summaries in seconds  */
+    string prometheus_text()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stringstream text;
+        for (auto& entry : counters)
+        {
+            text << "# TYPE logrank_" << entry.first << "_total counter\n";
+            text << "logrank_" << entry.first << "_total " << entry.second->value() << "\n";
+        }
+        for (auto& entry : gauges)
+        {
+            text << "# TYPE logrank_" << entry.first << " gauge\n";
+            text << "logrank_" << entry.first << " " << entry.second->value() << "\n";
+        }
+        for (auto& entry : histograms)
+        {
+            const string name = "logrank_" + entry.first + "_seconds";
+            text << "# TYPE " << name << " summary\n";
+            for (double quantile : {0.5, 0.9, 0.99, 0.999})
+            {
+                text << name << "{quantile=\"" << quantile << "\"} " << entry.second->percentile(quantile) * 1e-9
+                     << "\n";
+            }
+            text << name << "_sum " << entry.second->get_sum() * 1e-9 << "\n";
+            text << name << "_count " << entry.second->get_count() << "\n";
+        }
+        return text.str();
+    }
+
+    /*  {"counters": {name: value}, "gauges": {name: value}, "histograms": {name: {count, sum_ns, max_ns, p50_ns, ...}}}  */
+    string json_snapshot()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stringstream text;
+        text << "{\n  \"counters\": {";
+        bool first = true;
+        for (auto& entry : counters)
+        {
+            text << (first ? "\n" : ",\n") << "    \"" << entry.first << "\": " << entry.second->value();
+            first = false;
+        }
+        text << "\n  },\n  \"gauges\": {";
+        first = true;
+        for (auto& entry : gauges)
+        {
+            text << (first ? "\n" : ",\n") << "    \"" << entry.first << "\": " << entry.second->value();
+            first = false;
+        }
+        text << "\n  },\n  \"histograms\": {";
+        first = true;
+        for (auto& entry : histograms)
+        {
+            const Metrics_Histogram& histogram = *entry.second;
+            text << (first ? "\n" : ",\n") << "    \"" << entry.first << "\": {\"count\": " << histogram.get_count()
+                 << ", \"sum_ns\": " << histogram.get_sum() << ", \"max_ns\": " << histogram.get_max()
+                 << ", \"p50_ns\": " << histogram.percentile(0.5) << ", \"p90_ns\": " << histogram.percentile(0.9)
+                 << ", \"p99_ns\": " << histogram.percentile(0.99) << ", \"p999_ns\": "
+                 << histogram.percentile(0.999) << "}";
+            first = false;
+        }
+        text << "\n  }\n}\n";
+        return text.str();
+    }
+
+    void write_prometheus(const string& path)
+    {
+        write_atomically(path, prometheus_text());
+    }
+
+    void write_json(const string& path)
+    {
+        write_atomically(path, json_snapshot());
+    }
+};
+
+/*  The metrics of the protocol, registered once. Operation counters count homomorphic operations
+ *  (one per ciphertext operand), the histograms time whole stages. result_chain_index is the modulus
+ *  chain index of the last result the evaluator released (0 = the last level, no rescale left).  */
+struct Logrank_Metrics
+{
+    Metrics_Counter& encrypt;
+    Metrics_Counter& add;
+    Metrics_Counter& multiply;
+    Metrics_Counter& relinearize;
+    Metrics_Counter& rescale;
+    Metrics_Counter& decrypt;
+    Metrics_Counter& serialized_bytes;
+    Metrics_Counter& rejected_msgs;    // uploads dropped by the evaluator (no client_id, or a resend)
+    Metrics_Gauge& result_chain_index;
+    Metrics_Histogram& client_encrypt;
+    Metrics_Histogram& evaluator_merge;    // one merge of the channel into the running accumulator
+    Metrics_Histogram& evaluator_evaluate;
+    Metrics_Histogram& creator_decrypt;
+};
+
+inline Logrank_Metrics& logrank_metrics()
+{
+    static Logrank_Metrics metrics{
+        Metrics_Registry::global().counter("encrypt"),
+        Metrics_Registry::global().counter("add"),
+        Metrics_Registry::global().counter("multiply"),
+        Metrics_Registry::global().counter("relinearize"),
+        Metrics_Registry::global().counter("rescale"),
+        Metrics_Registry::global().counter("decrypt"),
+        Metrics_Registry::global().counter("serialized_bytes"),
+        Metrics_Registry::global().counter("rejected_msgs"),
+        Metrics_Registry::global().gauge("result_chain_index"),
+        Metrics_Registry::global().histogram("client_encrypt"),
+        Metrics_Registry::global().histogram("evaluator_merge"),
+        Metrics_Registry::global().histogram("evaluator_evaluate"),
+        Metrics_Registry::global().histogram("creator_decrypt")};
+    return metrics;
+}
+
+#endif // SEAL_METRICS_H
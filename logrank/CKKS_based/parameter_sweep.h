@@ -0,0 +1,119 @@
+//
+// Accuracy-versus-cost results of a parameter sweep and their Pareto frontier.
+//
+
+#ifndef SEAL_PARAMETER_SWEEP_H
+#define SEAL_PARAMETER_SWEEP_H
+
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+using namespace std;
+
+/*  The grid: every (poly_modulus_degree, scale_cost_param, randomized) triple is one configuration, run on
+ *  every input distribution. Triples whose modulus chain does not fit the degree are skipped.  */
+struct Sweep_Grid
+{
+    vector<size_t> poly_modulus_degrees = {8192, 16384};
+    vector<int> scale_cost_params = {20, 25, 30, 35, 40, 50};
+    vector<bool> randomized = {false, true};
+    int uniform_clients = 100;
+    int repetitions = 3;
+};
+
+/*  One configuration, aggregated over every distribution and repetition  */
+struct Sweep_Result
+{
+    size_t poly_modulus_degree;
+    int scale_cost_param;
+    bool randomized;
+    bool failed = false;        // the pipeline threw after some runs (e.g. the scale left the modulus)
+    size_t runs = 0;
+    double max_rel_error = 0;
+    double mean_rel_error = 0;
+    double mean_latency_ms = 0;
+    size_t ciphertext_bytes = 0;    // one client msg, serialized
+    long resident_kb = 0;
+    bool pareto = false;
+};
+
+/*  Record one run of a configuration: relative error of Z and online latency  */
+inline void add_sweep_run(Sweep_Result& result, double Z, double true_Z, double latency_ms)
+{
+    double error = std::abs((Z - true_Z) / true_Z);
+    if (!std::isfinite(error))
+    {
+        error = numeric_limits<double>::infinity();
+    }
+    result.max_rel_error = max(result.max_rel_error, error);
+    result.mean_rel_error += (error - result.mean_rel_error) / (result.runs + 1);
+    result.mean_latency_ms += (latency_ms - result.mean_latency_ms) / (result.runs + 1);
+    result.runs++;
+}
+
+/*  a dominates b: no worse in max error, latency and ciphertext size, and better in at least one  */
+inline bool sweep_dominates(const Sweep_Result& a, const Sweep_Result& b)
+{
+    bool no_worse = a.max_rel_error <= b.max_rel_error && a.mean_latency_ms <= b.mean_latency_ms &&
+                    a.ciphertext_bytes <= b.ciphertext_bytes;
+    bool better = a.max_rel_error < b.max_rel_error || a.mean_latency_ms < b.mean_latency_ms ||
+                  a.ciphertext_bytes < b.ciphertext_bytes;
+    return no_worse && better;
+}
+
+/*  Sets the pareto flag of every configuration no other one dominates. Failed configurations and those
+ *  above max_tolerated_error (the accuracy the analysis needs) are never on the frontier.  */
+inline void mark_pareto_frontier(vector<Sweep_Result>& results, double max_tolerated_error)
+{
+    for (Sweep_Result& candidate : results)
+    {
+        candidate.pareto = !candidate.failed && candidate.max_rel_error <= max_tolerated_error;
+        for (const Sweep_Result& other : results)
+        {
+            if (candidate.pareto && !other.failed && sweep_dominates(other, candidate))
+            {
+                candidate.pareto = false;
+            }
+        }
+    }
+}
+
+inline void write_sweep_csv(const vector<Sweep_Result>& results, const string& path)
+{
+    ofstream csv(path);
+    csv << "poly_modulus_degree,scale_cost_param,randomized,failed,runs,max_rel_error,mean_rel_error,"
+           "mean_latency_ms,ciphertext_bytes,resident_kb,pareto" << endl;
+    for (const Sweep_Result& r : results)
+    {
+        csv << r.poly_modulus_degree << "," << r.scale_cost_param << "," << r.randomized << "," << r.failed << ","
+            << r.runs << "," << r.max_rel_error << "," << r.mean_rel_error << "," << r.mean_latency_ms << ","
+            << r.ciphertext_bytes << "," << r.resident_kb << "," << r.pareto << endl;
+    }
+}
+
+/*  The frontier only, sorted as given (JSON has no infinity, so failed runs never get here)  */
+inline void write_pareto_json(const vector<Sweep_Result>& results, const string& path)
+{
+    ofstream json(path);
+    json << "[";
+    bool first = true;
+    for (const Sweep_Result& r : results)
+    {
+        if (!r.pareto)
+        {
+            continue;
+        }
+        json << (first ? "\n" : ",\n") << "  {\"poly_modulus_degree\": " << r.poly_modulus_degree
+             << ", \"scale_cost_param\": " << r.scale_cost_param
+             << ", \"randomized\": " << (r.randomized ? "true" : "false")
+             << ", \"max_rel_error\": " << r.max_rel_error << ", \"mean_rel_error\": " << r.mean_rel_error
+             << ", \"mean_latency_ms\": " << r.mean_latency_ms << ", \"ciphertext_bytes\": " << r.ciphertext_bytes
+             << ", \"resident_kb\": " << r.resident_kb << "}";
+        first = false;
+    }
+    json << "\n]" << endl;
+}
+
+#endif // SEAL_PARAMETER_SWEEP_H
@@ -0,0 +1,35 @@
+//
+// Permutation-test p-value from the slot-packed replicates.
+//
+
+#ifndef SEAL_PERMUTATION_TEST_H
+#define SEAL_PERMUTATION_TEST_H
+
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+/*  Slot 0 carries the observed (O-E, V), slots 1..B the permuted-label replicates
+ *  (see compute_permutation_statistics). Two-sided empirical p-value:
+ *      p = (1 + #{b : |Z_b| >= |Z_0|}) / (B + 1)
+ *  The +1 counts the observed labelling as one of the permutations, so p is never 0.
+ *  With 4096 slots B <= 4095, and the smallest attainable p is 1/4096.  */
+inline double permutation_p_value(const std::vector<double>& D_slots, const std::vector<double>& U_slots)
+{
+    if (D_slots.size() < 2 || D_slots.size() != U_slots.size())
+    {
+        throw std::invalid_argument("permutation_p_value: need the observed slot and at least one replicate");
+    }
+
+    /*  A relative tolerance on the comparison, so CKKS noise does not split ties (e.g. the identity permutation)  */
+    double observed = std::abs(D_slots[0]) / std::sqrt(U_slots[0]);
+    size_t at_least_as_extreme = 1;
+    for (size_t b = 1; b < D_slots.size(); b++)
+    {
+        double z = (U_slots[b] > 0) ? std::abs(D_slots[b]) / std::sqrt(U_slots[b]) : 0.0;
+        at_least_as_extreme += (z >= observed * (1 - 1e-4));
+    }
+    return (double)at_least_as_extreme / D_slots.size();
+}
+
+#endif // SEAL_PERMUTATION_TEST_H
@@ -98,6 +98,7 @@ void Logrank_protocol_5_clients_sim (int test_index) {
 
     /*  6. Measure performance of the online phase */
     measure_test_time(time_start);
+    print_peak_memory();
 }
 
 void example_logrank_5_clients_test()
@@ -0,0 +1,122 @@
+//
+// Soak test of the evaluator: record client uploads once, replay them at a set rate for a long run.
+//
+
+#include <exception>
+#include <fstream>
+#include <queue>
+#include <sys/stat.h>
+#include "../../../examples.h"
+#include "creator_server.h"
+#include "evaluator_server.h"
+#include "load_generator.h"
+#include "logrank_simulation.h"
+#include "serv_func.h"
+#include "spool.h"
+using namespace std;
+using namespace seal;
+
+/*  Encrypt num_of_recorded seeded uploads into the recording directory, unless it already holds a recording.
+ *  A kept recording was encrypted under other keys: fine for load, the replayed sums are never decrypted.  */
+static void record_uploads(const Replay_Config& config, std::shared_ptr<SEALContext> context,
+                           std::shared_ptr<CKKSEncoder> encoder, const PublicKey& public_key, double scale)
+{
+    ::mkdir(config.recording_dir.c_str(), 0700);
+    size_t recorded = list_spool(config.recording_dir).size();
+    if (recorded > 0)
+    {
+        cout << "Replaying the " << recorded << " uploads recorded in " << config.recording_dir << endl;
+        return;
+    }
+
+    Encryptor encryptor(context, public_key);
+    for (size_t i = 0; i < config.num_of_recorded; i++)
+    {
+        ClientsInput input = sample_client_input(config.seed, i);
+        Cipher_Msg msg = create_encrypted_msg(*encoder, encryptor, scale, input.O, input.E, input.V, input.r);
+        msg.client_id = (int)i;
+        spool_msg(config.recording_dir, msg, 0);
+    }
+    cout << "Recorded " << config.num_of_recorded << " uploads in " << config.recording_dir << endl;
+}
+
+void Logrank_replay_sim(const Replay_Config& config)
+{
+    cout << " -----------------------------" << endl;
+    cout << " ---START REPLAY LOAD TEST----" << endl;
+    cout << " -----------------------------" << endl;
+
+    const int scale_cost_param = 30;
+    double scale = pow(2.0, scale_cost_param);
+
+    std::queue<Cipher_Msg> enc_msg_q;
+    std::queue<Decrypted_Result> decrypted_result_q;
+    std::shared_ptr<SEALContext> context = create_context(scale_cost_param);
+    std::shared_ptr<CKKSEncoder> encoder = create_encoder(context);
+    creator_server key_server(context, encoder, &decrypted_result_q);
+    evaluator_server eval_server(context, key_server.get_relin_keys(), &enc_msg_q, scale);
+
+    record_uploads(config, context, encoder, key_server.get_public_key(), scale);
+    replay_load_generator generator(context, eval_server, enc_msg_q, config);
+
+    cout << config.rate << " uploads/s (" << (config.schedule == ARRIVAL_POISSON ? "poisson" : "constant")
+         << "), " << config.concurrency << " senders, " << config.duration_s << " s" << endl;
+
+    ofstream csv;
+    if (!config.csv_path.empty())
+    {
+        csv.open(config.csv_path);
+    }
+    const string header = "elapsed_s,sent,merged,merged_per_sec,p50_ms,p99_ms,p999_ms,max_ms,max_send_lag_ms,"
+                          "backlog,resident_kb";
+    cout << header << endl;
+    if (csv)
+    {
+        csv << header << endl;
+    }
+
+    generator.run([&](const Replay_Report& line) {
+        stringstream row;
+        row << line.elapsed_s << "," << line.sent << "," << line.merged << "," << line.merged_per_sec << ","
+            << line.p50_ms << "," << line.p99_ms << "," << line.p999_ms << "," << line.max_ms << ","
+            << line.max_send_lag_ms << "," << line.backlog << "," << current_memory_kb();
+        cout << row.str() << endl;
+        if (csv)
+        {
+            csv << row.str() << endl;
+        }
+    });
+
+    Metrics_Histogram& latency = Metrics_Registry::global().histogram("replay_latency");
+    print_line(__LINE__);
+    cout << "Whole run: " << latency.get_count() << " uploads, p50 " << latency.percentile(0.5) / 1e6 << " ms, p99 "
+         << latency.percentile(0.99) / 1e6 << " ms, p99.9 " << latency.percentile(0.999) / 1e6 << " ms, max "
+         << latency.get_max() / 1e6 << " ms" << endl;
+    print_peak_memory();
+}
+
+int run_replay_load(int argc, char* argv[])
+{
+    Replay_Config config;
+    try
+    {
+        config = parse_options(argc, argv, set_replay_option);
+    }
+    catch (const exception& e)
+    {
+        cerr << e.what() << endl;
+        cerr << "options: --config=FILE --recording=DIR --recorded=N --rate=R --schedule=constant|poisson"
+             << " --concurrency=C --duration=S --report_interval=S --seed=S --csv=FILE" << endl;
+        return 1;
+    }
+    Logrank_replay_sim(config);
+    return 0;
+}
+
+void example_replay_load_test()
+{
+    Replay_Config config;
+    config.duration_s = 30;
+    config.report_interval_s = 5;
+    Logrank_replay_sim(config);
+}
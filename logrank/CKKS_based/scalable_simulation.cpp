@@ -0,0 +1,230 @@
+//
+// Scalable simulation driver: parallel seeded inputs, bounded batches, throughput and memory curves.
+//
+
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <queue>
+#include <thread>
+#include "../../../examples.h"
+#include "creator_server.h"
+#include "evaluator_server.h"
+#include "logrank_simulation.h"
+#include "metrics.h"
+#include "serv_func.h"
+#include "simulation_config.h"
+#include "stage_memory.h"
+using namespace std;
+using namespace seal;
+
+struct Curve_Point
+{
+    int num_of_clients;
+    double generate_ms = 0;
+    double encrypt_ms = 0;
+    double aggregate_ms = 0;
+    double clients_per_sec = 0;
+    long max_resident_kb = 0;
+    long peak_kb = 0;
+    size_t stage_kb[NUM_OF_STAGES] = {};    // high-water of each stage's pool in this point
+    double Z = 0;
+    double true_Z = 0;
+};
+
+/*  work(thread, begin, end) on contiguous ranges of [0, count), one per thread  */
+static void parallel_for(size_t count, size_t num_threads, const function<void(size_t, size_t, size_t)>& work)
+{
+    num_threads = max((size_t)1, min(num_threads, count));
+    vector<thread> workers;
+    for (size_t t = 0; t < num_threads; t++)
+    {
+        workers.emplace_back(work, t, count * t / num_threads, count * (t + 1) / num_threads);
+    }
+    for (thread& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+static double elapsed_ms(chrono::high_resolution_clock::time_point time_start)
+{
+    return chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - time_start).count()
+           / 1000.0;
+}
+
+/*  One point of the curves: num_of_clients go through generate -> encrypt -> merge batch_size at a time,
+ *  so only one batch of ciphertexts is alive at any moment. The evaluator keeps just the running sums.  */
+static Curve_Point run_curve_point(const Simulation_Config& config, int num_of_clients,
+                                   std::shared_ptr<SEALContext> context, std::shared_ptr<CKKSEncoder> encoder,
+                                   creator_server& key_server, std::queue<Decrypted_Result>& decrypted_result_q)
+{
+    /*  Every point is a separate study: the stages start from empty pools  */
+    Stage_Memory_Pools::global().reset_all();
+
+    double scale = pow(2.0, config.scale_cost_param);
+    std::queue<Cipher_Msg> enc_msg_q;
+    evaluator_server eval_server(context, key_server.get_relin_keys(), &enc_msg_q, scale);
+
+    /*  Encryptors are per thread; the encoder is shared (encode is const)  */
+    vector<Encryptor*> encryptors;
+    for (size_t t = 0; t < config.num_threads; t++)
+    {
+        encryptors.push_back(new Encryptor(context, key_server.get_public_key()));
+    }
+
+    Curve_Point point;
+    point.num_of_clients = num_of_clients;
+    double sigma_O = 0, sigma_E = 0, sigma_V = 0;
+
+    for (size_t first = 0; first < (size_t)num_of_clients; first += config.batch_size)
+    {
+        size_t count = min(config.batch_size, (size_t)num_of_clients - first);
+
+        /*  1. Inputs, from the per-client streams  */
+        chrono::high_resolution_clock::time_point time_start = chrono::high_resolution_clock::now();
+        vector<ClientsInput> inputs(count);
+        parallel_for(count, config.num_threads, [&](size_t, size_t begin, size_t end) {
+            for (size_t j = begin; j < end; j++)
+            {
+                inputs[j] = sample_client_input(config.seed, first + j);
+            }
+        });
+        point.generate_ms += elapsed_ms(time_start);
+
+        for (const ClientsInput& input : inputs)
+        {
+            sigma_O += input.O;
+            sigma_E += input.E;
+            sigma_V += input.V;
+        }
+
+        /*  2. Encryption  */
+        time_start = chrono::high_resolution_clock::now();
+        vector<Cipher_Msg> msgs(count);
+        parallel_for(count, config.num_threads, [&](size_t t, size_t begin, size_t end) {
+            for (size_t j = begin; j < end; j++)
+            {
+                msgs[j] = create_encrypted_msg(*encoder, *encryptors[t], scale, inputs[j].O, inputs[j].E,
+                                               inputs[j].V, inputs[j].r);
+                msgs[j].client_id = (int)(first + j);
+            }
+        });
+        point.encrypt_ms += elapsed_ms(time_start);
+
+        /*  3. Upload and merge into the running sums  */
+        time_start = chrono::high_resolution_clock::now();
+        for (Cipher_Msg& msg : msgs)
+        {
+            enc_msg_q.push(std::move(msg));
+        }
+        eval_server.merge_arrivals();
+        point.aggregate_ms += elapsed_ms(time_start);
+
+        point.max_resident_kb = max(point.max_resident_kb, current_memory_kb());
+    }
+
+    for (Encryptor* encryptor : encryptors)
+    {
+        delete encryptor;
+    }
+
+    key_server.decrypt_msg(eval_server.get_provisional_result(num_of_clients).result);
+    point.Z = decrypted_result_q.front().D / sqrt(decrypted_result_q.front().U);
+    decrypted_result_q.pop();
+    point.true_Z = (sigma_O - sigma_E) / sqrt(sigma_V);
+
+    point.clients_per_sec =
+        num_of_clients * 1000.0 / max(1.0, point.generate_ms + point.encrypt_ms + point.aggregate_ms);
+    point.peak_kb = peak_memory_kb();
+    for (int stage = 0; stage < NUM_OF_STAGES; stage++)
+    {
+        point.stage_kb[stage] = Stage_Memory_Pools::global().arena_bytes((Logrank_Stage)stage) / 1024;
+    }
+    return point;
+}
+
+void Logrank_scalable_sim(const Simulation_Config& config)
+{
+    cout << " -------------------------------" << endl;
+    cout << " ---START SCALABLE SIMULATION---" << endl;
+    cout << " -------------------------------" << endl;
+
+    std::queue<Decrypted_Result> decrypted_result_q;
+    std::shared_ptr<SEALContext> context = create_context(config.scale_cost_param);
+    std::shared_ptr<CKKSEncoder> encoder = create_encoder(context);
+    creator_server key_server(context, encoder, &decrypted_result_q);
+
+    cout << "seed " << config.seed << ", " << config.num_threads << " threads, batches of " << config.batch_size
+         << " clients" << endl;
+
+    ofstream csv;
+    if (!config.csv_path.empty())
+    {
+        csv.open(config.csv_path);
+    }
+    const string header = "clients,threads,batch,generate_ms,encrypt_ms,aggregate_ms,clients_per_sec,"
+                          "max_resident_kb,peak_kb,encrypt_pool_kb,aggregate_pool_kb,multiply_pool_kb,"
+                          "decrypt_pool_kb,Z,true_Z";
+    cout << header << endl;
+    if (csv)
+    {
+        csv << header << endl;
+    }
+
+    for (int num_of_clients : config.client_counts)
+    {
+        Curve_Point point = run_curve_point(config, num_of_clients, context, encoder, key_server, decrypted_result_q);
+
+        stringstream row;
+        row << point.num_of_clients << "," << config.num_threads << "," << config.batch_size << ","
+            << point.generate_ms << "," << point.encrypt_ms << "," << point.aggregate_ms << ","
+            << point.clients_per_sec << "," << point.max_resident_kb << "," << point.peak_kb << ",";
+        for (size_t stage_kb : point.stage_kb)
+        {
+            row << stage_kb << ",";
+        }
+        row << point.Z << "," << point.true_Z;
+        cout << row.str() << endl;
+        if (csv)
+        {
+            csv << row.str() << endl;
+        }
+        if (!config.metrics_path.empty())
+        {
+            Metrics_Registry::global().write_prometheus(config.metrics_path + ".prom");
+            Metrics_Registry::global().write_json(config.metrics_path + ".json");
+        }
+
+        if (std::abs((point.Z - point.true_Z) / point.true_Z) > 0.001)
+        {
+            cout << "---- ERROR!! ----- the gap is : " << std::abs((point.Z - point.true_Z) / point.true_Z) << endl;
+            throw;
+        }
+    }
+    Stage_Memory_Pools::global().print_report();
+}
+
+/*  Scriptable entry point: logrank --clients=1000,10000,100000 --threads=16 --batch=64 --csv=curve.csv  */
+int run_scalable_simulation(int argc, char* argv[])
+{
+    Simulation_Config config;
+    try
+    {
+        config = parse_simulation_config(argc, argv);
+    }
+    catch (const exception& e)
+    {
+        cerr << e.what() << endl;
+        cerr << "options: --config=FILE --clients=N[,N...] --seed=S --threads=T --batch=B --scale_bits=K --csv=FILE"
+             << " --metrics=PREFIX" << endl;
+        return 1;
+    }
+    Logrank_scalable_sim(config);
+    return 0;
+}
+
+void example_scalable_logrank_test()
+{
+    Logrank_scalable_sim(Simulation_Config());
+}
@@ -5,7 +5,10 @@
 #ifndef SEAL_SERV_FUNC_H
 #define SEAL_SERV_FUNC_H
 
+#include <set>
 #include "../../../examples.h"
+#include "metrics.h"
+#include "stage_memory.h"
 
 using namespace std;
 using namespace seal;
@@ -16,11 +19,27 @@ enum MultiplicatioType
     SQUARE =1
 };
 
+/*  Cipher_Msg and Encrypted_Result are move-only: a ciphertext is allocated once at encryption and
+ *  is handed from the channel to the evaluator and on to the creator server without a deep copy.
+ *  A ciphertext is ~0.5MB, so an accidental copy is a compile error rather than a silent memcpy.  */
 struct Cipher_Msg
 {
     Ciphertext enc_O_minus_E;
     Ciphertext enc_V;
     Ciphertext enc_r;
+
+    /*  The sender, so the evaluator can report which clients a (provisional) result covers. -1 if unknown. */
+    int client_id = -1;
+
+    /*  Which slice of a multi-ciphertext message this is (e.g. Kaplan-Meier bins beyond one ciphertext)  */
+    int chunk_index = 0;
+
+    Cipher_Msg() = default;
+    explicit Cipher_Msg(MemoryPoolHandle pool) : enc_O_minus_E(pool), enc_V(pool), enc_r(pool) {}
+    Cipher_Msg(Cipher_Msg&&) = default;
+    Cipher_Msg& operator=(Cipher_Msg&&) = default;
+    Cipher_Msg(const Cipher_Msg&) = delete;
+    Cipher_Msg& operator=(const Cipher_Msg&) = delete;
 };
 
 struct Basic_Vectors
@@ -34,56 +53,103 @@ struct Encrypted_Result
 {
     Ciphertext D_encrypted;
     Ciphertext U_encrypted;
+
+    /*  Set instead of D and U when Z is computed under encryption (evaluator_server::evaluate_z)  */
+    Ciphertext Z_encrypted;
+
+    Encrypted_Result() = default;
+    Encrypted_Result(Encrypted_Result&&) = default;
+    Encrypted_Result& operator=(Encrypted_Result&&) = default;
+    Encrypted_Result(const Encrypted_Result&) = delete;
+    Encrypted_Result& operator=(const Encrypted_Result&) = delete;
+};
+
+/*  What the creator server ships to the evaluator at setup. relin_keys is the serialization of
+ *  KeyGenerator::relin_keys(): seeded (half of every key is regenerated from a seed by the evaluator)
+ *  and compressed. Empty when the evaluator's circuits never relinearize (plain aggregation).  */
+struct Evaluator_Key_Bundle
+{
+    string relin_keys;
+
+    size_t size() const
+    {
+        return relin_keys.size();
+    }
+};
+
+/*  A result over the clients that arrived so far. complete is false if some expected clients are missing.  */
+struct Provisional_Result
+{
+    Encrypted_Result result;
+    set<int> contributors;
+    bool complete;
+    bool no_contributors = false;    // nothing merged yet: result is empty
 };
 
 struct Decrypted_Result
 {
     double D;
     double U;
+
+    /*  The first slots of the decoded D and U, for messages that pack several statistics into one ciphertext.
+     *  D_slots[0] == D and U_slots[0] == U.  */
+    vector<double> D_slots;
+    vector<double> U_slots;
+
+    /*  Only set by creator_server::decrypt_z_msg, which never sees D and U  */
+    double Z = 0;
+    vector<double> Z_slots;
 };
 
 inline Cipher_Msg create_encrypted_msg(CKKSEncoder& encoder, Encryptor& encryptor, double scale, double O, double E, double V, double r)
 {
-    Plaintext plain_O_minus_E, plain_V, plain_r;
-    encoder.encode(O - E, scale, plain_O_minus_E);
-    encoder.encode(V, scale, plain_V);
-    encoder.encode(r, scale, plain_r);
+    MemoryPoolHandle pool = stage_pool(STAGE_CLIENT_ENCRYPT);
+    Plaintext plain_O_minus_E(pool), plain_V(pool), plain_r(pool);
+    encoder.encode(O - E, scale, plain_O_minus_E, pool);
+    encoder.encode(V, scale, plain_V, pool);
+    encoder.encode(r, scale, plain_r, pool);
 
-    Cipher_Msg cipher;
-    encryptor.encrypt(plain_O_minus_E, cipher.enc_O_minus_E);
-    encryptor.encrypt(plain_V, cipher.enc_V);
-    encryptor.encrypt(plain_r, cipher.enc_r);
+    Cipher_Msg cipher(pool);
+    encryptor.encrypt(plain_O_minus_E, cipher.enc_O_minus_E, pool);
+    encryptor.encrypt(plain_V, cipher.enc_V, pool);
+    encryptor.encrypt(plain_r, cipher.enc_r, pool);
+    logrank_metrics().encrypt.add(3);
 
     return (cipher);
 }
 
-inline Basic_Vectors create_basic_vectors(vector<Cipher_Msg> msg_vec)
+/*  The msgs are consumed: each ciphertext is moved (not copied) into its field vector  */
+inline Basic_Vectors create_basic_vectors(vector<Cipher_Msg>&& msg_vec)
 {
     Basic_Vectors basicVectors;
+    basicVectors.r_encrypted_vector.reserve(msg_vec.size());
+    basicVectors.T0_encrypted_vector.reserve(msg_vec.size());
+    basicVectors.T1_encrypted_vector.reserve(msg_vec.size());
     for (unsigned long i=0; i< msg_vec.size(); i++)
     {
-        basicVectors.r_encrypted_vector.push_back(msg_vec[i].enc_r);
-        basicVectors.T0_encrypted_vector.push_back(msg_vec[i].enc_O_minus_E);
-        basicVectors.T1_encrypted_vector.push_back(msg_vec[i].enc_V);
+        basicVectors.r_encrypted_vector.push_back(std::move(msg_vec[i].enc_r));
+        basicVectors.T0_encrypted_vector.push_back(std::move(msg_vec[i].enc_O_minus_E));
+        basicVectors.T1_encrypted_vector.push_back(std::move(msg_vec[i].enc_V));
     }
+    msg_vec.clear();
     return basicVectors;
 }
 
-inline Basic_Vectors create_basic_vectors(Cipher_Msg& cipher_msg_1, Cipher_Msg& cipher_msg_2, Cipher_Msg& cipher_msg_3)
+inline Basic_Vectors create_basic_vectors(Cipher_Msg&& cipher_msg_1, Cipher_Msg&& cipher_msg_2, Cipher_Msg&& cipher_msg_3)
 {
     Basic_Vectors basicVectors;
 
-    basicVectors.r_encrypted_vector.push_back(cipher_msg_1.enc_r);
-    basicVectors.r_encrypted_vector.push_back(cipher_msg_2.enc_r);
-    basicVectors.r_encrypted_vector.push_back(cipher_msg_3.enc_r);
+    basicVectors.r_encrypted_vector.push_back(std::move(cipher_msg_1.enc_r));
+    basicVectors.r_encrypted_vector.push_back(std::move(cipher_msg_2.enc_r));
+    basicVectors.r_encrypted_vector.push_back(std::move(cipher_msg_3.enc_r));
 
-    basicVectors.T0_encrypted_vector.push_back(cipher_msg_1.enc_O_minus_E);
-    basicVectors.T0_encrypted_vector.push_back(cipher_msg_2.enc_O_minus_E);
-    basicVectors.T0_encrypted_vector.push_back(cipher_msg_3.enc_O_minus_E);
+    basicVectors.T0_encrypted_vector.push_back(std::move(cipher_msg_1.enc_O_minus_E));
+    basicVectors.T0_encrypted_vector.push_back(std::move(cipher_msg_2.enc_O_minus_E));
+    basicVectors.T0_encrypted_vector.push_back(std::move(cipher_msg_3.enc_O_minus_E));
 
-    basicVectors.T1_encrypted_vector.push_back(cipher_msg_1.enc_V);
-    basicVectors.T1_encrypted_vector.push_back(cipher_msg_2.enc_V);
-    basicVectors.T1_encrypted_vector.push_back(cipher_msg_3.enc_V);
+    basicVectors.T1_encrypted_vector.push_back(std::move(cipher_msg_1.enc_V));
+    basicVectors.T1_encrypted_vector.push_back(std::move(cipher_msg_2.enc_V));
+    basicVectors.T1_encrypted_vector.push_back(std::move(cipher_msg_3.enc_V));
 
     return basicVectors;
 }
@@ -92,7 +158,9 @@ inline void calculate_sigma(Evaluator& evaluator, vector<Ciphertext>& basicVecto
 {
     print_line(__LINE__);
     cout << "Compute sigma_" << str << "_encrypted. No relinearize, No rescale" << endl;
+    sigma_encrypted = Ciphertext(stage_pool(STAGE_AGGREGATE));
     evaluator.add_many(basicVectorsField, sigma_encrypted);
+    logrank_metrics().add.add(basicVectorsField.size() - 1);
     cout << "    + size of sigma_" << str << "_encrypted: " << sigma_encrypted.size() << endl;
     cout << "    + Scale of sigma_" << str << "_encrypted: " << log2(sigma_encrypted.scale()) << " bits" << endl;
 }
@@ -118,18 +186,22 @@ inline void general_multiply_relinearize_and_rescale(Evaluator& evaluator, Ciphe
 {
     print_line(__LINE__);
     cout << "Compute multiply and relinearize and rescale" << endl;
+    MemoryPoolHandle pool = stage_pool(STAGE_MULTIPLY);
+    result = Ciphertext(pool);
     if(multiplicatioType == MULTIPLY)
     {
-        evaluator.multiply(first_arg, second_arg, result);
+        evaluator.multiply(first_arg, second_arg, result, pool);
     }
     else
     {
-        evaluator.square(first_arg, result);
+        evaluator.square(first_arg, result, pool);
     }
     cout << "    + size of " << name << " (before relinearization): " << result.size() << endl;
     cout << "    + result::save_size: "
          << result.save_size() << endl;
-    evaluator.relinearize_inplace(result, relin_keys);
+    evaluator.relinearize_inplace(result, relin_keys, pool);
+    logrank_metrics().multiply.add();
+    logrank_metrics().relinearize.add();
     cout << "    + size of " << name << " (after relinearization): " << result.size() << endl;
     cout << "    + Scale of " << name << " before rescale: " << log2(result.scale()) << " bits" << endl;
     cout << "    + result::save_size: "
@@ -141,7 +213,8 @@ inline void general_multiply_relinearize_and_rescale(Evaluator& evaluator, Ciphe
     to 2^30: this is because the 30-bit prime is only close to 2^30.
     */
 
-    evaluator.rescale_to_next_inplace(result);
+    evaluator.rescale_to_next_inplace(result, pool);
+    logrank_metrics().rescale.add();
     cout << "    + Scale of "<< name << " after rescale: " << log2(result.scale()) << " bits" << endl;
     cout << "    + result::save_size: "
          << result.save_size() << endl;
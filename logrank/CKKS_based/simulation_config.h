@@ -0,0 +1,159 @@
+//
+// Configuration of the scalable simulation driver, from the command line or a file.
+//
+
+#ifndef SEAL_SIMULATION_CONFIG_H
+#define SEAL_SIMULATION_CONFIG_H
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+/*  batch_size bounds the ciphertexts in memory at once (about 1.5 MB per client at poly_modulus_degree
+ *  8192), independently of the number of clients. Every client_counts entry is one point of the
+ *  throughput and memory curves.  */
+struct Simulation_Config
+{
+    vector<int> client_counts = {1000, 10000, 100000};
+    uint64_t seed = 1;
+    size_t num_threads = max(1u, std::thread::hardware_concurrency());
+    size_t batch_size = 64;
+    int scale_cost_param = 30;
+    string csv_path;    // empty: the curves go to cout only
+    string metrics_path;    // empty: no export; else <path>.prom and <path>.json after every curve point
+};
+
+inline void set_config_option(Simulation_Config& config, const string& key, const string& value)
+{
+    if (key == "clients")
+    {
+        /*  A comma-separated list: 1000,10000,100000  */
+        config.client_counts.clear();
+        stringstream list(value);
+        string count;
+        while (getline(list, count, ','))
+        {
+            config.client_counts.push_back(stoi(count));
+        }
+    }
+    else if (key == "seed")
+    {
+        config.seed = stoull(value);
+    }
+    else if (key == "threads")
+    {
+        config.num_threads = max(1ul, stoul(value));
+    }
+    else if (key == "batch")
+    {
+        config.batch_size = max(1ul, stoul(value));
+    }
+    else if (key == "scale_bits")
+    {
+        config.scale_cost_param = stoi(value);
+    }
+    else if (key == "csv")
+    {
+        config.csv_path = value;
+    }
+    else if (key == "metrics")
+    {
+        config.metrics_path = value;
+    }
+    else
+    {
+        throw invalid_argument("unknown simulation option: " + key);
+    }
+}
+
+/*  key=value per line, '#' starts a comment. set_option throws on an unknown key.  */
+template <class Config>
+inline void load_options_file(Config& config, const string& path,
+                              void (*set_option)(Config&, const string&, const string&))
+{
+    ifstream file(path);
+    if (!file)
+    {
+        throw invalid_argument("cannot open the simulation config " + path);
+    }
+    string line;
+    while (getline(file, line))
+    {
+        line = line.substr(0, line.find('#'));
+        size_t equals = line.find('=');
+        if (equals == string::npos)
+        {
+            continue;
+        }
+        auto trim = [](const string& s) {
+            size_t first = s.find_first_not_of(" \t\r");
+            size_t last = s.find_last_not_of(" \t\r");
+            return (first == string::npos) ? string() : s.substr(first, last - first + 1);
+        };
+        set_option(config, trim(line.substr(0, equals)), trim(line.substr(equals + 1)));
+    }
+}
+
+/*  --key=value for every option, and --config=path to read a file first: the file is applied before every
+ *  other flag, wherever --config appears, so the flags always override it  */
+template <class Config>
+inline Config parse_options(int argc, char* argv[], void (*set_option)(Config&, const string&, const string&))
+{
+    vector<pair<string, string>> options;
+    string config_path;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        size_t equals = arg.find('=');
+        if (arg.compare(0, 2, "--") != 0 || equals == string::npos)
+        {
+            throw invalid_argument("expected --key=value, got " + arg);
+        }
+        string key = arg.substr(2, equals - 2);
+        string value = arg.substr(equals + 1);
+        if (key == "config")
+        {
+            if (!config_path.empty())
+            {
+                throw invalid_argument("--config given more than once");
+            }
+            config_path = value;
+        }
+        else
+        {
+            options.emplace_back(key, value);
+        }
+    }
+
+    Config config;
+    if (!config_path.empty())
+    {
+        load_options_file(config, config_path, set_option);
+    }
+    for (const auto& option : options)
+    {
+        set_option(config, option.first, option.second);
+    }
+    return config;
+}
+
+inline void load_config_file(Simulation_Config& config, const string& path)
+{
+    load_options_file(config, path, set_config_option);
+}
+
+/*      logrank --config=sweep.cfg --clients=1000,100000 --threads=16 --batch=128 --seed=7 --csv=curve.csv
+ *              --metrics=run1  */
+inline Simulation_Config parse_simulation_config(int argc, char* argv[])
+{
+    return parse_options(argc, argv, set_config_option);
+}
+
+/*  The driver (scalable_simulation.cpp): parses the flags above and writes the curves  */
+int run_scalable_simulation(int argc, char* argv[]);
+
+#endif // SEAL_SIMULATION_CONFIG_H
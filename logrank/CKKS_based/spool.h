@@ -0,0 +1,183 @@
+//
+// On-disk spool of uploaded ciphertexts for studies that do not fit in memory.
+//
+
+#ifndef SEAL_SPOOL_H
+#define SEAL_SPOOL_H
+
+#include <algorithm>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include "../../../examples.h"
+#include "evaluator_checkpoint.h"
+#include "serv_func.h"
+
+/*  Every upload lands as one file in the spool directory, in the record layout of the checkpoint log:
+ *      [uint8 present][uint64 size][ciphertext]   for enc_O_minus_E, enc_V, enc_r
+ *  The file is written under a temporary name and renamed, so the evaluator never sees a partial upload.  */
+static const string SPOOL_SUFFIX = ".ctx";
+
+inline string spool_msg(const string& spool_dir, const Cipher_Msg& msg, size_t seq)
+{
+    string name = spool_dir + "/msg_" + to_string(msg.client_id) + "_" + to_string(seq);
+    {
+        std::ofstream outfile(name + ".tmp", std::ofstream::binary);
+        checkpoint_detail::put_cipher(outfile, msg.enc_O_minus_E);
+        checkpoint_detail::put_cipher(outfile, msg.enc_V);
+        checkpoint_detail::put_cipher(outfile, msg.enc_r);
+        if (!outfile)
+        {
+            throw runtime_error("spool_msg: cannot write " + name);
+        }
+        logrank_metrics().serialized_bytes.add(outfile.tellp());
+    }
+    if (::rename((name + ".tmp").c_str(), (name + SPOOL_SUFFIX).c_str()) != 0)
+    {
+        throw runtime_error("spool_msg: cannot publish " + name);
+    }
+    return name + SPOOL_SUFFIX;
+}
+
+/*  The completed uploads in the spool, sorted so that every run visits them in the same order  */
+inline vector<string> list_spool(const string& spool_dir)
+{
+    vector<string> files;
+    DIR* dir = ::opendir(spool_dir.c_str());
+    if (!dir)
+    {
+        throw runtime_error("list_spool: cannot open " + spool_dir);
+    }
+    while (struct dirent* entry = ::readdir(dir))
+    {
+        string name = entry->d_name;
+        if (name.size() > SPOOL_SUFFIX.size() &&
+            name.compare(name.size() - SPOOL_SUFFIX.size(), SPOOL_SUFFIX.size(), SPOOL_SUFFIX) == 0)
+        {
+            files.push_back(spool_dir + "/" + name);
+        }
+    }
+    ::closedir(dir);
+    sort(files.begin(), files.end());
+    return files;
+}
+
+/*  Parse one upload record (the layout above) from memory  */
+inline void load_spool_record(std::shared_ptr<SEALContext> context, const SEAL_BYTE* data, size_t size,
+                              Cipher_Msg& msg)
+{
+    size_t offset = 0;
+    for (Ciphertext* cipher : {&msg.enc_O_minus_E, &msg.enc_V, &msg.enc_r})
+    {
+        if (offset + 1 > size)
+        {
+            throw runtime_error("load_spool_record: truncated record");
+        }
+        uint8_t present = data[offset++];
+        if (!present)
+        {
+            *cipher = Ciphertext();
+            continue;
+        }
+        uint64_t length;
+        if (offset + sizeof(length) > size)
+        {
+            throw runtime_error("load_spool_record: truncated record");
+        }
+        std::copy(data + offset, data + offset + sizeof(length), (SEAL_BYTE*)&length);
+        offset += sizeof(length);
+        if (offset + length > size)
+        {
+            throw runtime_error("load_spool_record: truncated record");
+        }
+        cipher->load(context, data + offset, length);
+        offset += length;
+    }
+}
+
+/*  A whole spool file in memory, for records that are parsed many times (see load_generator.h)  */
+inline vector<SEAL_BYTE> read_spool_file(const string& path)
+{
+    std::ifstream infile(path, std::ifstream::binary | std::ifstream::ate);
+    if (!infile)
+    {
+        throw runtime_error("read_spool_file: cannot open " + path);
+    }
+    vector<SEAL_BYTE> bytes((size_t)infile.tellg());
+    infile.seekg(0);
+    infile.read((char*)bytes.data(), bytes.size());
+    if (!infile)
+    {
+        throw runtime_error("read_spool_file: cannot read " + path);
+    }
+    return bytes;
+}
+
+/*  A read-only mapping of one spool file. The pages are read sequentially once, and dropped from
+ *  the page cache on release so that a 100k-file pass does not evict everything else.  */
+class spool_file
+{
+private:
+    int fd = -1;
+    size_t size = 0;
+    const SEAL_BYTE* data = nullptr;
+
+public:
+    explicit spool_file(const string& path)
+    {
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw runtime_error("spool_file: cannot open " + path);
+        }
+        struct stat info;
+        if (::fstat(fd, &info) != 0)
+        {
+            ::close(fd);
+            throw runtime_error("spool_file: cannot stat " + path);
+        }
+        size = info.st_size;
+        void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED)
+        {
+            ::close(fd);
+            throw runtime_error("spool_file: cannot map " + path);
+        }
+        ::madvise(mapped, size, MADV_SEQUENTIAL);
+        data = (const SEAL_BYTE*)mapped;
+    }
+
+    ~spool_file()
+    {
+        ::munmap((void*)data, size);
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(fd);
+    }
+
+    spool_file(const spool_file&) = delete;
+    spool_file& operator=(const spool_file&) = delete;
+
+    /*  Parse the three ciphertexts straight out of the mapping  */
+    void load(std::shared_ptr<SEALContext> context, Cipher_Msg& msg) const
+    {
+        load_spool_record(context, data, size, msg);
+    }
+
+    /*  Ask the kernel to start reading a file that will be loaded soon  */
+    static void prefetch(const string& path)
+    {
+        int prefetch_fd = ::open(path.c_str(), O_RDONLY);
+        if (prefetch_fd >= 0)
+        {
+            ::posix_fadvise(prefetch_fd, 0, 0, POSIX_FADV_WILLNEED);
+            ::close(prefetch_fd);
+        }
+    }
+};
+
+#endif // SEAL_SPOOL_H
@@ -0,0 +1,98 @@
+//
+// Out-of-core evaluation of a large study from the on-disk spool.
+//
+
+#include <cstdio>
+#include <exception>
+#include <queue>
+#include <sys/stat.h>
+#include "../../../examples.h"
+#include "client.h"
+#include "creator_server.h"
+#include "evaluator_server.h"
+#include "logrank_simulation.h"
+#include "serv_func.h"
+#include "spool.h"
+using namespace std;
+using namespace seal;
+
+/*  num_of_clients distinct sites encrypt once; each upload is spooled `replicas` times, so the spool
+ *  holds num_of_clients * replicas contributions without paying for that many encryptions.  */
+void Logrank_spool_sim(int num_of_clients, int replicas, const vector<size_t>& thread_counts)
+{
+    cout << " ----------------------------" << endl;
+    cout << " ---START SPOOL SIMULATION---" << endl;
+    cout << " ----------------------------" << endl;
+
+    const string spool_dir = "logrank_spool";
+    ::mkdir(spool_dir.c_str(), 0700);
+
+    std::queue<Cipher_Msg> enc_msg_q;
+    std::queue<Decrypted_Result> decrypted_result_q;
+
+    const int scale_cost_param = 30;
+    double scale = pow(2.0, scale_cost_param);
+
+    std::shared_ptr<SEALContext> context = create_context(scale_cost_param);
+    std::shared_ptr<CKKSEncoder> encoder = create_encoder(context);
+
+    vector<ClientsInput> inputs(num_of_clients);
+    sample_inputs_clients(inputs.data(), num_of_clients);
+
+    double sigma_O = 0, sigma_E = 0, sigma_V = 0;
+    for (int i=0; i<num_of_clients; i++)
+    {
+        sigma_O += replicas * inputs[i].O;
+        sigma_E += replicas * inputs[i].E;
+        sigma_V += replicas * inputs[i].V;
+    }
+    double trueResult = ((sigma_O - sigma_E) / sqrt(sigma_V));
+    cout << " True value: " << trueResult << endl;
+
+    creator_server key_server(context, encoder, &decrypted_result_q);
+    evaluator_server eval_server(context, key_server.get_relin_keys(), &enc_msg_q, scale);
+
+    /*  Uploads: encrypt, spool, and drop the ciphertext - nothing stays in memory  */
+    chrono::high_resolution_clock::time_point time_start = chrono::high_resolution_clock::now();
+    vector<string> spooled;
+    for (int i=0; i<num_of_clients; i++)
+    {
+        client site(context, encoder, key_server.get_public_key(), &enc_msg_q, &decrypted_result_q, scale,
+                    inputs[i].O, inputs[i].E, inputs[i].V, inputs[i].r, i);
+        site.get_encryped_msg();
+        for (int rep=0; rep<replicas; rep++)
+        {
+            spooled.push_back(spool_msg(spool_dir, enc_msg_q.front(), rep));
+        }
+        enc_msg_q.pop();
+    }
+    cout << "Spooled " << spooled.size() << " uploads" << endl;
+    measure_test_time(time_start);
+
+    client reader(context, encoder, key_server.get_public_key(), &enc_msg_q, &decrypted_result_q, scale, 0, 0, 0, 1.0);
+    for (size_t num_threads : thread_counts)
+    {
+        time_start = chrono::high_resolution_clock::now();
+        Encrypted_Result result = eval_server.evaluate_from_spool(spool_dir, num_threads);
+        chrono::microseconds eval_time =
+            chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - time_start);
+
+        key_server.decrypt_msg(result);
+        verify_result(&reader, trueResult);
+
+        cout << "    + " << num_threads << " threads: " << eval_time.count() / 1000 << " ms, "
+             << spooled.size() * 1000000.0 / max(1.0, (double)eval_time.count()) << " uploads/s" << endl;
+    }
+    print_peak_memory();
+
+    for (const string& file : spooled)
+    {
+        std::remove(file.c_str());
+    }
+    ::rmdir(spool_dir.c_str());
+}
+
+void example_spool_logrank_test()
+{
+    Logrank_spool_sim(100, 100, {1, 2, 4, 8});
+}
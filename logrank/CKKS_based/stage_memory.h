@@ -0,0 +1,126 @@
+//
+// Per-stage SEAL memory pools: every stage of the protocol allocates from its own resettable arena.
+//
+
+#ifndef SEAL_STAGE_MEMORY_H
+#define SEAL_STAGE_MEMORY_H
+
+#include <algorithm>
+#include <mutex>
+#include "../../../examples.h"
+
+using namespace std;
+using namespace seal;
+
+enum Logrank_Stage
+{
+    STAGE_CLIENT_ENCRYPT = 0,
+    STAGE_AGGREGATE = 1,
+    STAGE_MULTIPLY = 2,    // multiply, relinearize and rescale
+    STAGE_DECRYPT = 3,
+    NUM_OF_STAGES = 4
+};
+
+inline const char* stage_name(Logrank_Stage stage)
+{
+    static const char* names[NUM_OF_STAGES] = {"client_encrypt", "aggregate", "multiply_relin_rescale", "decrypt"};
+    return names[stage];
+}
+
+/*  One SEAL memory pool per stage instead of the global default pool, which never shrinks and cannot tell
+ *  the stages apart. A stage passes its pool to every SEAL call that takes one and builds its output
+ *  ciphertexts and plaintexts on it, so both the temporaries and the results of the stage are counted there.
+ *
+ *  A pool never gives memory back while it lives, so the bytes it has allocated are the high-water mark of
+ *  the stage since its last reset. reset() swaps in a fresh pool; the old one is freed as soon as the last
+ *  ciphertext allocated from it is gone (a ciphertext keeps its pool alive).
+ *
+ *  The pools are passed explicitly rather than through MMProfGuard: a memory profile switch is global to
+ *  the process, so a guard would serialize the encryption threads and deadlock when stages nest.  */
+class Stage_Memory_Pools
+{
+private:
+    std::mutex mutex;
+    MemoryPoolHandle pools[NUM_OF_STAGES];
+
+    /*  The largest arena of each stage since the start, over the resets  */
+    size_t peak_bytes[NUM_OF_STAGES] = {};
+
+    void update_peak(Logrank_Stage stage)
+    {
+        peak_bytes[stage] = max(peak_bytes[stage], pools[stage].alloc_byte_count());
+    }
+
+public:
+    Stage_Memory_Pools()
+    {
+        for (int stage = 0; stage < NUM_OF_STAGES; stage++)
+        {
+            pools[stage] = MemoryManager::GetPool(mm_prof_opt::FORCE_NEW);
+        }
+    }
+    Stage_Memory_Pools(const Stage_Memory_Pools&) = delete;
+    Stage_Memory_Pools& operator=(const Stage_Memory_Pools&) = delete;
+
+    static Stage_Memory_Pools& global()
+    {
+        static Stage_Memory_Pools stage_pools;
+        return stage_pools;
+    }
+
+    /*  The pools are thread safe (FORCE_NEW pools are multi-threaded), so concurrent encryptors share one  */
+    MemoryPoolHandle pool(Logrank_Stage stage)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return pools[stage];
+    }
+
+    /*  Bytes allocated by the current arena of the stage, i.e. its high-water mark since the last reset  */
+    size_t arena_bytes(Logrank_Stage stage)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return pools[stage].alloc_byte_count();
+    }
+
+    size_t get_peak_bytes(Logrank_Stage stage)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        update_peak(stage);
+        return peak_bytes[stage];
+    }
+
+    void reset(Logrank_Stage stage)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        update_peak(stage);
+        pools[stage] = MemoryManager::GetPool(mm_prof_opt::FORCE_NEW);
+    }
+
+    /*  Between studies: every stage starts again from an empty arena  */
+    void reset_all()
+    {
+        for (int stage = 0; stage < NUM_OF_STAGES; stage++)
+        {
+            reset((Logrank_Stage)stage);
+        }
+    }
+
+    void print_report()
+    {
+        print_line(__LINE__);
+        cout << "Memory by stage (current arena / peak):" << endl;
+        for (int stage = 0; stage < NUM_OF_STAGES; stage++)
+        {
+            cout << "    + " << stage_name((Logrank_Stage)stage) << ": "
+                 << arena_bytes((Logrank_Stage)stage) / 1024 << " KB / "
+                 << get_peak_bytes((Logrank_Stage)stage) / 1024 << " KB" << endl;
+        }
+    }
+};
+
+inline MemoryPoolHandle stage_pool(Logrank_Stage stage)
+{
+    return Stage_Memory_Pools::global().pool(stage);
+}
+
+#endif // SEAL_STAGE_MEMORY_H
@@ -0,0 +1,533 @@
+//
+// Site-side data preparation: load raw survival records and compute O, E, V.
+//
+
+#ifndef SEAL_SURVIVAL_DATA_LOADER_H
+#define SEAL_SURVIVAL_DATA_LOADER_H
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/*  Raw survival records are held column-wise: one contiguous array per field.
+ *  group holds the arm label. In the two-group test group == 1 is the arm whose observed events are counted
+ *  in O, every other label is the reference arm. The K-sample test uses labels 0..K-1. */
+struct Survival_Columns
+{
+    std::vector<double> time;
+    std::vector<uint8_t> event;
+    std::vector<uint8_t> group;
+
+    size_t size() const { return time.size(); }
+
+    void reserve(size_t n)
+    {
+        time.reserve(n);
+        event.reserve(n);
+        group.reserve(n);
+    }
+
+    void push_back(double t, uint8_t e, uint8_t g)
+    {
+        time.push_back(t);
+        event.push_back(e);
+        group.push_back(g);
+    }
+};
+
+/*  The site's logrank contribution.
+ *  The per-time-point vectors are indexed by the distinct event times of the site (ascending). */
+struct Site_Statistics
+{
+    double O = 0;
+    double E = 0;
+    double V = 0;
+
+    std::vector<double> event_times;
+    std::vector<double> d;      // number of events at t_j
+    std::vector<double> d1;     // number of events in group 1 at t_j
+    std::vector<double> n;      // number at risk at t_j
+    std::vector<double> n1;     // number at risk in group 1 at t_j
+    std::vector<double> E_t;    // n1 * d / n
+    std::vector<double> V_t;    // hypergeometric variance at t_j
+};
+
+/*  Binary columnar format:
+ *  [8 bytes magic][uint64 row count][double time * count][uint8 event * count][uint8 group * count]  */
+static const char SURVIVAL_BINARY_MAGIC[8] = {'L', 'R', 'C', 'O', 'L', '0', '0', '1'};
+
+namespace survival_loader_detail
+{
+    /*  Parse one "time,event,group" line. Returns false for lines that are not numeric (e.g. the CSV header). */
+    inline bool parse_csv_line(const char* begin, const char* end, Survival_Columns& columns)
+    {
+        char* pos;
+        double t = strtod(begin, &pos);
+        if (pos == begin || pos >= end || *pos != ',')
+        {
+            return false;
+        }
+        const char* field = pos + 1;
+        long e = strtol(field, &pos, 10);
+        if (pos == field || pos >= end || *pos != ',')
+        {
+            return false;
+        }
+        field = pos + 1;
+        if (field >= end)
+        {
+            return false;
+        }
+        /*  strtol skips newlines, so it can run into the next line: the group must end within this one,
+         *  followed by nothing but whitespace (e.g. the \r of a CRLF file)  */
+        long g = strtol(field, &pos, 10);
+        if (pos == field || pos > end)
+        {
+            return false;
+        }
+        for (const char* rest = pos; rest < end; rest++)
+        {
+            if (!isspace((unsigned char)*rest))
+            {
+                return false;
+            }
+        }
+        /*  Labels are stored in one byte (also in the binary cache), so a larger one would wrap to another arm  */
+        if (g < 0 || g > 255)
+        {
+            throw std::invalid_argument("parse_csv_line: group label " + std::to_string(g) + " is outside [0, 255]");
+        }
+        columns.push_back(t, (uint8_t)(e != 0), (uint8_t)g);
+        return true;
+    }
+}
+
+/*  Stream a "time,event,group" CSV file in fixed-size chunks. A header line is skipped.
+ *  The file is never held in memory as a whole - only the chunk buffer and the parsed columns.  */
+inline Survival_Columns load_survival_csv(const std::string& path, size_t chunk_size = 1 << 20)
+{
+    std::ifstream infile(path, std::ifstream::binary);
+    if (!infile)
+    {
+        throw std::runtime_error("load_survival_csv: cannot open " + path);
+    }
+
+    Survival_Columns columns;
+    std::vector<char> buffer(chunk_size + 1);
+    std::string carry;
+    size_t line_number = 0;
+
+    while (infile)
+    {
+        infile.read(buffer.data(), chunk_size);
+        size_t got = infile.gcount();
+        if (got == 0)
+        {
+            break;
+        }
+        buffer[got] = '\0';    // strtod/strtol never scan into a previous chunk
+
+        const char* p = buffer.data();
+        const char* end = p + got;
+        while (p < end)
+        {
+            const char* nl = (const char*)memchr(p, '\n', end - p);
+            if (!nl)
+            {
+                /*  The last line of the chunk continues in the next chunk  */
+                carry.append(p, end);
+                break;
+            }
+
+            bool parsed;
+            if (!carry.empty())
+            {
+                carry.append(p, nl);
+                parsed = survival_loader_detail::parse_csv_line(carry.data(), carry.data() + carry.size(), columns);
+                carry.clear();
+            }
+            else
+            {
+                parsed = survival_loader_detail::parse_csv_line(p, nl, columns);
+            }
+            if (!parsed && line_number > 0 && nl - p > 1)
+            {
+                throw std::runtime_error("load_survival_csv: malformed line " + std::to_string(line_number + 1));
+            }
+            line_number++;
+            p = nl + 1;
+        }
+    }
+    if (!carry.empty() &&
+        !survival_loader_detail::parse_csv_line(carry.data(), carry.data() + carry.size(), columns) &&
+        line_number > 0)
+    {
+        throw std::runtime_error("load_survival_csv: malformed line " + std::to_string(line_number + 1));
+    }
+
+    return columns;
+}
+
+inline void save_survival_binary(const std::string& path, const Survival_Columns& columns)
+{
+    std::ofstream outfile(path, std::ofstream::binary);
+    if (!outfile)
+    {
+        throw std::runtime_error("save_survival_binary: cannot open " + path);
+    }
+    uint64_t count = columns.size();
+    outfile.write(SURVIVAL_BINARY_MAGIC, sizeof(SURVIVAL_BINARY_MAGIC));
+    outfile.write((const char*)&count, sizeof(count));
+    outfile.write((const char*)columns.time.data(), count * sizeof(double));
+    outfile.write((const char*)columns.event.data(), count);
+    outfile.write((const char*)columns.group.data(), count);
+}
+
+/*  Each column is read with a single bulk read straight into its destination array  */
+inline Survival_Columns load_survival_binary(const std::string& path)
+{
+    std::ifstream infile(path, std::ifstream::binary);
+    if (!infile)
+    {
+        throw std::runtime_error("load_survival_binary: cannot open " + path);
+    }
+
+    char magic[sizeof(SURVIVAL_BINARY_MAGIC)];
+    uint64_t count = 0;
+    infile.read(magic, sizeof(magic));
+    infile.read((char*)&count, sizeof(count));
+    if (!infile || memcmp(magic, SURVIVAL_BINARY_MAGIC, sizeof(magic)) != 0)
+    {
+        throw std::runtime_error("load_survival_binary: bad header in " + path);
+    }
+
+    Survival_Columns columns;
+    columns.time.resize(count);
+    columns.event.resize(count);
+    columns.group.resize(count);
+    infile.read((char*)columns.time.data(), count * sizeof(double));
+    infile.read((char*)columns.event.data(), count);
+    infile.read((char*)columns.group.data(), count);
+    if (!infile)
+    {
+        throw std::runtime_error("load_survival_binary: truncated file " + path);
+    }
+
+    return columns;
+}
+
+/*  Compute the site's O, E and V.
+ *  1. Sort the rows by time (a packed key keeps the sort cache friendly).
+ *  2. One pass over the sorted rows collapses them to distinct times with event / leaving counts.
+ *  3. Risk-set sizes are suffix sums of the leaving counts.
+ *  4. E_t and V_t are computed by branch-free loops over contiguous arrays, which the compiler vectorizes. */
+inline Site_Statistics compute_site_statistics(const Survival_Columns& columns)
+{
+    struct Row
+    {
+        double time;
+        uint32_t event;
+        uint32_t group;
+    };
+
+    size_t rows = columns.size();
+    std::vector<Row> sorted(rows);
+    for (size_t i = 0; i < rows; i++)
+    {
+        sorted[i] = Row{columns.time[i], columns.event[i], (uint32_t)(columns.group[i] == 1)};
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const Row& a, const Row& b) { return a.time < b.time; });
+
+    /*  Collapse to distinct times  */
+    std::vector<double> times, d, d1, leaving, leaving1;
+    for (size_t i = 0; i < rows;)
+    {
+        double t = sorted[i].time;
+        double events = 0, events1 = 0, out = 0, out1 = 0;
+        for (; i < rows && sorted[i].time == t; i++)
+        {
+            events += sorted[i].event;
+            events1 += sorted[i].event & sorted[i].group;
+            out += 1;
+            out1 += sorted[i].group;
+        }
+        times.push_back(t);
+        d.push_back(events);
+        d1.push_back(events1);
+        leaving.push_back(out);
+        leaving1.push_back(out1);
+    }
+
+    /*  Risk sets: n_j = number of rows with time >= t_j  */
+    size_t m = times.size();
+    std::vector<double> n(m), n1(m);
+    std::partial_sum(leaving.rbegin(), leaving.rend(), n.rbegin());
+    std::partial_sum(leaving1.rbegin(), leaving1.rend(), n1.rbegin());
+
+    /*  Keep only the event times  */
+    Site_Statistics stats;
+    for (size_t j = 0; j < m; j++)
+    {
+        if (d[j] > 0)
+        {
+            stats.event_times.push_back(times[j]);
+            stats.d.push_back(d[j]);
+            stats.d1.push_back(d1[j]);
+            stats.n.push_back(n[j]);
+            stats.n1.push_back(n1[j]);
+        }
+    }
+
+    size_t k = stats.event_times.size();
+    stats.E_t.resize(k);
+    stats.V_t.resize(k);
+    const double* pd = stats.d.data();
+    const double* pn = stats.n.data();
+    const double* pn1 = stats.n1.data();
+    double* pE = stats.E_t.data();
+    double* pV = stats.V_t.data();
+    for (size_t j = 0; j < k; j++)
+    {
+        double share = pn1[j] / pn[j];
+        double ties = (pn[j] > 1) ? (pn[j] - pd[j]) / (pn[j] - 1) : 0.0;
+        pE[j] = share * pd[j];
+        pV[j] = share * (1.0 - share) * pd[j] * ties;
+    }
+
+    stats.O = std::accumulate(stats.d1.begin(), stats.d1.end(), 0.0);
+    stats.E = std::accumulate(stats.E_t.begin(), stats.E_t.end(), 0.0);
+    stats.V = std::accumulate(stats.V_t.begin(), stats.V_t.end(), 0.0);
+
+    return stats;
+}
+
+/*  The part of the site's O, E, V contributed by the event times in (from, to].
+ *  With a common study start, the risk set at t_j <= to is the same at every later look, so the
+ *  contribution of an accrual window never changes once the window is closed.  */
+inline void window_statistics(const Site_Statistics& stats, double from, double to, double& O, double& E, double& V)
+{
+    auto first = std::upper_bound(stats.event_times.begin(), stats.event_times.end(), from);
+    auto last = std::upper_bound(stats.event_times.begin(), stats.event_times.end(), to);
+    size_t begin = first - stats.event_times.begin();
+    size_t end = last - stats.event_times.begin();
+
+    O = std::accumulate(stats.d1.begin() + begin, stats.d1.begin() + end, 0.0);
+    E = std::accumulate(stats.E_t.begin() + begin, stats.E_t.begin() + end, 0.0);
+    V = std::accumulate(stats.V_t.begin() + begin, stats.V_t.begin() + end, 0.0);
+}
+
+/*  Weight functions of the weighted logrank family. At event time t_j:
+ *  LOGRANK: w = 1, GEHAN: w = n_j, TARONE_WARE: w = sqrt(n_j),
+ *  FLEMING_HARRINGTON(p, q): w = S(t_j-)^p * (1 - S(t_j-))^q where S is the site's Kaplan-Meier estimate. */
+enum Logrank_Weight_Type
+{
+    LOGRANK_WEIGHT = 0,
+    GEHAN_WEIGHT = 1,
+    TARONE_WARE_WEIGHT = 2,
+    FLEMING_HARRINGTON_WEIGHT = 3
+};
+
+struct Logrank_Weight
+{
+    Logrank_Weight_Type type;
+    double p;
+    double q;
+};
+
+/*  Weighted (O - E) and V terms, one entry per weight function:
+ *  O_minus_E_w[k] = sum_j w_k(t_j) * (d1_j - E_t_j),   V_w[k] = sum_j w_k(t_j)^2 * V_t_j  */
+inline void compute_weighted_statistics(const Site_Statistics& stats, const std::vector<Logrank_Weight>& weights,
+                                        std::vector<double>& O_minus_E_w, std::vector<double>& V_w)
+{
+    size_t k = stats.event_times.size();
+
+    /*  Left-continuous Kaplan-Meier estimate S(t_j-)  */
+    std::vector<double> S_minus(k);
+    double S = 1.0;
+    for (size_t j = 0; j < k; j++)
+    {
+        S_minus[j] = S;
+        S *= 1.0 - stats.d[j] / stats.n[j];
+    }
+
+    O_minus_E_w.assign(weights.size(), 0.0);
+    V_w.assign(weights.size(), 0.0);
+    std::vector<double> w(k);
+    for (size_t i = 0; i < weights.size(); i++)
+    {
+        const Logrank_Weight& weight = weights[i];
+        for (size_t j = 0; j < k; j++)
+        {
+            switch (weight.type)
+            {
+            case LOGRANK_WEIGHT:
+                w[j] = 1.0;
+                break;
+            case GEHAN_WEIGHT:
+                w[j] = stats.n[j];
+                break;
+            case TARONE_WARE_WEIGHT:
+                w[j] = sqrt(stats.n[j]);
+                break;
+            case FLEMING_HARRINGTON_WEIGHT:
+                w[j] = pow(S_minus[j], weight.p) * pow(1.0 - S_minus[j], weight.q);
+                break;
+            }
+        }
+
+        double sum_O_minus_E = 0, sum_V = 0;
+        for (size_t j = 0; j < k; j++)
+        {
+            sum_O_minus_E += w[j] * (stats.d1[j] - stats.E_t[j]);
+            sum_V += w[j] * w[j] * stats.V_t[j];
+        }
+        O_minus_E_w[i] = sum_O_minus_E;
+        V_w[i] = sum_V;
+    }
+}
+
+/*  K-sample logrank terms of the site, for arm labels 0..K-1 (arm K-1 is left out, its terms are implied).
+ *  U[k]           = sum_j (d_kj - n_kj * d_j / n_j)                                      k < K-1
+ *  V[k*(K-1) + l] = sum_j d_j (n_j - d_j) / (n_j - 1) * n_kj / n_j * (delta_kl - n_lj / n_j)   k, l < K-1 */
+inline void compute_k_sample_statistics(const Survival_Columns& columns, int K,
+                                        std::vector<double>& U, std::vector<double>& V)
+{
+    size_t rows = columns.size();
+    std::vector<size_t> order(rows);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return columns.time[a] < columns.time[b]; });
+
+    /*  Collapse to distinct times. Per-arm counts are stored time-major: entry [j * K + k]  */
+    std::vector<double> d, d_arm, leaving_arm;
+    for (size_t i = 0; i < rows;)
+    {
+        double t = columns.time[order[i]];
+        size_t base = d_arm.size();
+        d_arm.resize(base + K, 0.0);
+        leaving_arm.resize(base + K, 0.0);
+        double events = 0;
+        for (; i < rows && columns.time[order[i]] == t; i++)
+        {
+            size_t row = order[i];
+            int arm = columns.group[row];
+            if (arm >= K)
+            {
+                throw std::invalid_argument("compute_k_sample_statistics: arm label out of range");
+            }
+            events += columns.event[row];
+            d_arm[base + arm] += columns.event[row];
+            leaving_arm[base + arm] += 1;
+        }
+        d.push_back(events);
+    }
+
+    /*  Risk sets per arm are suffix sums over the distinct times  */
+    size_t m = d.size();
+    std::vector<double> n_arm(m * K, 0.0);
+    std::vector<double> running(K, 0.0);
+    for (size_t j = m; j-- > 0;)
+    {
+        for (int k = 0; k < K; k++)
+        {
+            running[k] += leaving_arm[j * K + k];
+            n_arm[j * K + k] = running[k];
+        }
+    }
+
+    int dim = K - 1;
+    U.assign(dim, 0.0);
+    V.assign(dim * dim, 0.0);
+    for (size_t j = 0; j < m; j++)
+    {
+        if (d[j] == 0)
+        {
+            continue;
+        }
+        const double* nj_arm = &n_arm[j * K];
+        double nj = std::accumulate(nj_arm, nj_arm + K, 0.0);
+        double ties = (nj > 1) ? d[j] * (nj - d[j]) / (nj - 1) : 0.0;
+        for (int k = 0; k < dim; k++)
+        {
+            double pk = nj_arm[k] / nj;
+            U[k] += d_arm[j * K + k] - pk * d[j];
+            for (int l = 0; l < dim; l++)
+            {
+                double pl = nj_arm[l] / nj;
+                V[k * dim + l] += ties * pk * ((k == l ? 1.0 : 0.0) - pl);
+            }
+        }
+    }
+}
+
+/*  Permutation replicates of the site's (O-E, V). Replicate 0 uses the observed arm labels, replicate
+ *  b >= 1 a uniform shuffle of them (seeded with seed, so every run is reproducible). Every site shuffles
+ *  its own labels, which is the stratified permutation test with the sites as strata.
+ *  The time ordering does not depend on the labels, so the rows are sorted once and each replicate is O(rows). */
+inline void compute_permutation_statistics(const Survival_Columns& columns, size_t replicates, uint64_t seed,
+                                           std::vector<double>& O_minus_E, std::vector<double>& V)
+{
+    size_t rows = columns.size();
+    std::vector<size_t> order(rows);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return columns.time[a] < columns.time[b]; });
+
+    /*  Distinct times: [first[j], first[j+1]) in the sorted order. d_j and n_j are label free  */
+    std::vector<size_t> first;
+    std::vector<uint8_t> event(rows);
+    std::vector<uint8_t> labels(rows);
+    std::vector<double> d, n;
+    for (size_t i = 0; i < rows; i++)
+    {
+        event[i] = columns.event[order[i]];
+        labels[i] = (columns.group[order[i]] == 1);
+        if (i == 0 || columns.time[order[i]] != columns.time[order[i - 1]])
+        {
+            first.push_back(i);
+            d.push_back(0);
+            n.push_back(rows - i);
+        }
+        d.back() += event[i];
+    }
+    first.push_back(rows);
+    size_t m = d.size();
+
+    std::mt19937_64 gen(seed);
+    O_minus_E.assign(replicates + 1, 0.0);
+    V.assign(replicates + 1, 0.0);
+    for (size_t b = 0; b <= replicates; b++)
+    {
+        if (b > 0)
+        {
+            std::shuffle(labels.begin(), labels.end(), gen);
+        }
+        double n1 = std::accumulate(labels.begin(), labels.end(), 0.0);
+        for (size_t j = 0; j < m; j++)
+        {
+            double d1 = 0, out1 = 0;
+            for (size_t i = first[j]; i < first[j + 1]; i++)
+            {
+                d1 += event[i] & labels[i];
+                out1 += labels[i];
+            }
+            if (d[j] > 0)
+            {
+                double share = n1 / n[j];
+                double ties = (n[j] > 1) ? (n[j] - d[j]) / (n[j] - 1) : 0.0;
+                O_minus_E[b] += d1 - share * d[j];
+                V[b] += share * (1.0 - share) * d[j] * ties;
+            }
+            n1 -= out1;
+        }
+    }
+}
+
+#endif // SEAL_SURVIVAL_DATA_LOADER_H
@@ -0,0 +1,182 @@
+//
+// Parameter sweep: accuracy, latency, ciphertext size and memory over a grid, and the Pareto frontier.
+//
+
+#include <exception>
+#include <queue>
+#include "../../../examples.h"
+#include "creator_server.h"
+#include "evaluator_server.h"
+#include "logrank_simulation.h"
+#include "parameter_sweep.h"
+#include "real_values_simulation.h"
+#include "serv_func.h"
+using namespace std;
+using namespace seal;
+
+/*  The input distributions of the sweep: the five Mainz cases, uniform inputs as in the other simulations,
+ *  and small counts (O < 32, as sample_inputs_3_clients), where a coarse scale loses the most  */
+static vector<vector<ClientsInput>> sweep_distributions(int uniform_clients, uint64_t seed)
+{
+    vector<vector<ClientsInput>> distributions;
+    for (int test_index = 0; test_index < 5; test_index++)
+    {
+        Inputs5Clients mainz = take_inputs_from_data(test_index);
+        distributions.push_back({{mainz.O1, mainz.E1, mainz.V1, mainz.r1}, {mainz.O2, mainz.E2, mainz.V2, mainz.r2},
+                                 {mainz.O3, mainz.E3, mainz.V3, mainz.r3}, {mainz.O4, mainz.E4, mainz.V4, mainz.r4},
+                                 {mainz.O5, mainz.E5, mainz.V5, mainz.r5}});
+    }
+
+    vector<ClientsInput> uniform(uniform_clients), small(uniform_clients);
+    mt19937_64 gen(seed);
+    for (int i = 0; i < uniform_clients; i++)
+    {
+        uniform[i] = sample_client_input(seed, i);
+        small[i].O = gen() % 32;
+        small[i].E = (double) (gen() % 32000)/1000;
+        small[i].V = (double) (gen() % 32000)/1000;
+        small[i].r = (double) (gen() % 16);
+    }
+    distributions.push_back(uniform);
+    distributions.push_back(small);
+    return distributions;
+}
+
+/*  One online phase (encrypt, evaluate, decrypt) on one input set. The uploads carry enc_r as well, since
+ *  evaluate_with_random needs it.  */
+static void run_sweep_case(Sweep_Result& result, CKKSEncoder& encoder, Encryptor& encryptor,
+                           creator_server& key_server, evaluator_server& eval_server,
+                           std::queue<Cipher_Msg>& enc_msg_q, std::queue<Decrypted_Result>& decrypted_result_q,
+                           double scale, const vector<ClientsInput>& inputs)
+{
+    double sigma_O = 0, sigma_E = 0, sigma_V = 0;
+    for (const ClientsInput& input : inputs)
+    {
+        sigma_O += input.O;
+        sigma_E += input.E;
+        sigma_V += input.V;
+    }
+    double true_Z = (sigma_O - sigma_E) / sqrt(sigma_V);
+
+    chrono::high_resolution_clock::time_point time_start = chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        Cipher_Msg msg = create_encrypted_msg(encoder, encryptor, scale, inputs[i].O, inputs[i].E, inputs[i].V,
+                                              inputs[i].r);
+        msg.client_id = (int)i;
+        enc_msg_q.push(std::move(msg));
+    }
+    if (result.ciphertext_bytes == 0)
+    {
+        const Cipher_Msg& msg = enc_msg_q.front();
+        result.ciphertext_bytes = msg.enc_O_minus_E.save_size() + msg.enc_V.save_size() + msg.enc_r.save_size();
+    }
+    Encrypted_Result encrypted = result.randomized ? eval_server.evaluate_with_random() : eval_server.evaluate();
+    key_server.decrypt_msg(encrypted);
+    double latency_ms =
+        chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - time_start).count() / 1000.0;
+
+    const Decrypted_Result& decrypted = decrypted_result_q.front();
+    add_sweep_run(result, decrypted.D / sqrt(decrypted.U), true_Z, latency_ms);
+    result.resident_kb = max(result.resident_kb, current_memory_kb());
+}
+
+/*  Every configuration of the grid on every distribution, repetitions times (fresh uniform and small inputs
+ *  per repetition). The frontier minimizes max error, latency and ciphertext size among the configurations
+ *  within tolerance.  */
+vector<Sweep_Result> Logrank_parameter_sweep(const Sweep_Grid& grid, double tolerance, const string& csv_path,
+                                             const string& json_path)
+{
+    cout << " -------------------------------" << endl;
+    cout << " ---START PARAMETER SWEEP-------" << endl;
+    cout << " -------------------------------" << endl;
+
+    vector<Sweep_Result> results;
+    for (size_t poly_modulus_degree : grid.poly_modulus_degrees)
+    {
+        for (int scale_cost_param : grid.scale_cost_params)
+        {
+            std::shared_ptr<SEALContext> context;
+            try
+            {
+                context = create_sized_context(poly_modulus_degree, scale_cost_param);
+            }
+            catch (const exception& e)
+            {
+                /*  invalid_argument for a chain that does not fit the degree, logic_error from
+                 *  CoeffModulus::Create when there are not enough NTT-friendly primes of the size  */
+                cout << "skipped poly " << poly_modulus_degree << ", scale 2^" << scale_cost_param << ": " << e.what()
+                     << endl;
+                continue;
+            }
+
+            for (bool randomized : grid.randomized)
+            {
+                Sweep_Result result;
+                result.poly_modulus_degree = poly_modulus_degree;
+                result.scale_cost_param = scale_cost_param;
+                result.randomized = randomized;
+
+                try
+                {
+                    std::queue<Cipher_Msg> enc_msg_q;
+                    std::queue<Decrypted_Result> decrypted_result_q;
+                    double scale = pow(2.0, scale_cost_param);
+                    std::shared_ptr<CKKSEncoder> encoder = create_encoder(context);
+                    creator_server key_server(context, encoder, &decrypted_result_q);
+                    evaluator_server eval_server(context, key_server.get_relin_keys(), &enc_msg_q, scale);
+                    Encryptor encryptor(context, key_server.get_public_key());
+
+                    for (int rep = 0; rep < grid.repetitions; rep++)
+                    {
+                        for (const vector<ClientsInput>& inputs : sweep_distributions(grid.uniform_clients, rep + 1))
+                        {
+                            run_sweep_case(result, *encoder, encryptor, key_server, eval_server, enc_msg_q,
+                                           decrypted_result_q, scale, inputs);
+                        }
+                    }
+                }
+                catch (const exception& e)
+                {
+                    cout << "failed: " << e.what() << endl;
+                    result.failed = true;
+                }
+                if (result.runs == 0)
+                {
+                    /*  Nothing was measured: not a grid point, whatever the cause  */
+                    cout << "skipped poly " << poly_modulus_degree << ", scale 2^" << scale_cost_param
+                         << (randomized ? ", randomized" : "") << ": no run completed" << endl;
+                    continue;
+                }
+
+                cout << "poly " << poly_modulus_degree << ", scale 2^" << scale_cost_param
+                     << (randomized ? ", randomized" : "") << ": max error " << result.max_rel_error
+                     << ", mean error " << result.mean_rel_error << ", " << result.mean_latency_ms << " ms, "
+                     << result.ciphertext_bytes << " bytes/msg" << endl;
+                results.push_back(result);
+            }
+        }
+    }
+
+    mark_pareto_frontier(results, tolerance);
+    write_sweep_csv(results, csv_path);
+    write_pareto_json(results, json_path);
+
+    print_line(__LINE__);
+    cout << "Pareto frontier (max relative error <= " << tolerance << "):" << endl;
+    for (const Sweep_Result& result : results)
+    {
+        if (result.pareto)
+        {
+            cout << "    + poly " << result.poly_modulus_degree << ", scale 2^" << result.scale_cost_param
+                 << (result.randomized ? ", randomized" : "") << ": max error " << result.max_rel_error << ", "
+                 << result.mean_latency_ms << " ms, " << result.ciphertext_bytes << " bytes/msg" << endl;
+        }
+    }
+    return results;
+}
+
+void example_parameter_sweep_test()
+{
+    Logrank_parameter_sweep(Sweep_Grid(), 0.001, "logrank_sweep.csv", "logrank_pareto.json");
+}
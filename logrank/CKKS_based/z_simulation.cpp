@@ -0,0 +1,128 @@
+//
+// Z = D / sqrt(U) under encryption against the plaintext formula.
+//
+
+#include <exception>
+#include <queue>
+#include "../../../examples.h"
+#include "client.h"
+#include "creator_server.h"
+#include "evaluator_server.h"
+#include "inverse_sqrt.h"
+#include "logrank_simulation.h"
+#include "serv_func.h"
+using namespace std;
+using namespace seal;
+
+/*  num_of_studies independent studies are packed into the slots (one study per slot), so a single
+ *  evaluation returns all their Z values.  */
+void Logrank_encrypted_z_sim(int num_of_clients, int num_of_studies, double tolerance)
+{
+    cout << " ----------------------------------" << endl;
+    cout << " ---START ENCRYPTED Z SIMULATION---" << endl;
+    cout << " ----------------------------------" << endl;
+
+    std::queue<Cipher_Msg> enc_msg_q;
+    std::queue<Decrypted_Result> decrypted_result_q;
+
+    /*  The range of U is public: every site reports V in [0, 4096), so with enough sites the pooled
+     *  variance is within [1024, 3072] per site.  */
+    double U_min = 1024.0 * num_of_clients;
+    double U_max = 3072.0 * num_of_clients;
+
+    const int scale_cost_param = 36;
+    double scale = pow(2.0, scale_cost_param);
+    size_t max_depth = (CoeffModulus::MaxBitCount(16384) - 120) / scale_cost_param;
+    Inverse_Sqrt_Plan plan = plan_inverse_sqrt(U_min, U_max, tolerance, max_depth);
+
+    std::shared_ptr<SEALContext> context = create_deep_context(scale_cost_param, plan.depth);
+    std::shared_ptr<CKKSEncoder> encoder = create_encoder(context);
+
+    creator_server key_server(context, encoder, &decrypted_result_q);
+    evaluator_server eval_server(context, key_server.get_relin_keys(), &enc_msg_q, scale);
+
+    /*  inputs[s][i] - client i of study s  */
+    vector<vector<ClientsInput>> inputs(num_of_studies, vector<ClientsInput>(num_of_clients));
+    vector<double> true_Z(num_of_studies);
+    for (int s=0; s<num_of_studies; s++)
+    {
+        sample_inputs_clients(inputs[s].data(), num_of_clients);
+        double sigma_D = 0, sigma_U = 0;
+        for (int i=0; i<num_of_clients; i++)
+        {
+            sigma_D += inputs[s][i].O - inputs[s][i].E;
+            sigma_U += inputs[s][i].V;
+        }
+        if (sigma_U < U_min || sigma_U > U_max)
+        {
+            cout << "Study " << s << ": U = " << sigma_U << " is outside the planned range" << endl;
+        }
+        true_Z[s] = sigma_D / sqrt(sigma_U);
+    }
+
+    vector<client*> clients(num_of_clients);
+    for (int i=0; i<num_of_clients; i++)
+    {
+        vector<double> O_minus_E(num_of_studies), V(num_of_studies);
+        for (int s=0; s<num_of_studies; s++)
+        {
+            O_minus_E[s] = inputs[s][i].O - inputs[s][i].E;
+            V[s] = inputs[s][i].V;
+        }
+        clients[i] = new client(context, encoder, key_server.get_public_key(), &enc_msg_q, &decrypted_result_q, scale,
+                                0, 0, 0, 1.0, i);
+        clients[i]->set_weighted_input(O_minus_E, V);
+    }
+
+    /*  1. Z under encryption  */
+    for (int i=0; i<num_of_clients; i++)
+    {
+        clients[i]->get_encryped_weighted_msg();
+    }
+    chrono::high_resolution_clock::time_point time_start = chrono::high_resolution_clock::now();
+    key_server.decrypt_z_msg(eval_server.evaluate_z(plan), num_of_studies);
+    chrono::microseconds encrypted_time =
+        chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - time_start);
+    vector<double> encrypted_Z = clients[0]->get_z_results();
+
+    /*  2. Baseline: decrypt D and U, Z in the clear  */
+    for (int i=0; i<num_of_clients; i++)
+    {
+        clients[i]->get_encryped_weighted_msg();
+    }
+    time_start = chrono::high_resolution_clock::now();
+    key_server.decrypt_msg(eval_server.evaluate(), num_of_studies);
+    vector<double> plaintext_Z = clients[0]->get_weighted_results();
+    chrono::microseconds plaintext_time =
+        chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - time_start);
+
+    /*  Relative to |Z|, or absolute for Z near 0  */
+    double max_error = 0, max_baseline_error = 0;
+    for (int s=0; s<num_of_studies; s++)
+    {
+        double magnitude = max(1.0, std::abs(true_Z[s]));
+        max_error = max(max_error, std::abs(encrypted_Z[s] - true_Z[s]) / magnitude);
+        max_baseline_error = max(max_baseline_error, std::abs(plaintext_Z[s] - true_Z[s]) / magnitude);
+    }
+
+    cout << "Z for " << num_of_studies << " studies of " << num_of_clients << " sites:" << endl;
+    cout << "    + encrypted Z: " << encrypted_time.count() / 1000 << " ms, max error " << max_error << endl;
+    cout << "    + decrypted D and U: " << plaintext_time.count() / 1000 << " ms, max error "
+         << max_baseline_error << endl;
+    cout << "    + approximation bound: " << plan.max_rel_error << " relative" << endl;
+    if (max_error > plan.max_rel_error + 0.001)
+    {
+        cout << "---- ERROR!! ----- encrypted Z is off by " << max_error << endl;
+        throw;
+    }
+
+    for (int i=0; i<num_of_clients; i++)
+    {
+        delete clients[i];
+    }
+}
+
+void example_encrypted_z_test()
+{
+    Logrank_encrypted_z_sim(50, 256, 1e-4);
+}